@@ -55,11 +55,7 @@ void init() {
   SetExitKey(KEY_NULL); // Prevent ESC to be default exit key.
   SetTargetFPS(144);
 
-  // Load all game textures, fonts and sounds.
-  AssetManager::load_textures();
-  AssetManager::load_sounds();
-  AssetManager::load_fonts();
-
+  // Starts loading the textures, fonts and sounds in the background.
   game.init_game();
 }
 
@@ -95,6 +91,8 @@ void OnRender() {
 void cleanup() {
   // De-Initialization
   // ----------------------------------------------------------------------------------------------------
+  game.unload_game();              // Unload the level meshes
+  AssetManager::cancel_loading();  // Drop assets that are still loading
   AssetManager::unload_textures(); // Unload loaded data (textures)
   AssetManager::unload_sounds();   // Unload loaded data (sounds, music)
   AssetManager::unload_fonts();    // Unload loaded data (fonts)
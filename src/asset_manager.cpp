@@ -7,121 +7,800 @@
 // Copyright (C) 2024
 // Author: Johannes Elsing <je305@students.uni-freiburg.de>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "raylib.h"
 
 #include "./asset_manager.h"
+#include "./asset_pack.h"
+#include "./texture_atlas.h"
+
+#if defined(INVERSION_EMBED_ASSETS)
+// Asset pack linked into the executable, see embedded_pack.S.
+extern "C" const unsigned char inversion_pack_data[];
+extern "C" const uint64_t inversion_pack_size;
+#endif
 
 namespace Inversion::AssetManager {
 
 // ----------------------------------------------------------------------------------------------------
 // Static variables definition (internal linkage)
 // ----------------------------------------------------------------------------------------------------
-// Store textures/fonts/sound for the game.
-static std::unordered_map<std::string, Texture2D> textures;
-static std::unordered_map<std::string, Font> fonts;
-static std::unordered_map<std::string, Sound> sounds;
-static std::unordered_map<std::string, Music> music;
+// Store textures/fonts/sound for the game, indexed by their handles.
+static std::array<Texture2D, TEXTURE_COUNT> textures;
+static std::array<Font, FONT_COUNT> fonts;
+static std::array<Sound, SOUND_COUNT> sounds;
+static std::array<Music, MUSIC_COUNT> music;
+
+// Asset names in handle order, relative to the asset directory.
+static constexpr std::array<const char *, TEXTURE_COUNT> texture_files = {
+    "Sprites/free-emojis-pixelart/emojis-x2-64x64/E17.png",
+    "Sprites/free-emojis-pixelart/emojis-x2-64x64/E5.png",
+    "Sprites/free-emojis-pixelart/emojis-x2-64x64/E4.png",
+    "Sprites/free-emojis-pixelart/emojis-x2-64x64/E37.png",
+    "Sprites/free-emojis-pixelart/emojis-x2-64x64/E13.png",
+    "Sprites/Armorstand.png",
+    "Sprites/flag.png",
+    "Sprites/Tiles-and-Enemies.png",
+    "Sprites/yellow/1.png",
+    "Sprites/yellow/2.png",
+    "Sprites/yellow/3.png",
+    "Sprites/yellow/4.png",
+    "Sprites/yellow/5.png",
+    "Sprites/yellow/6.png",
+    "Sprites/yellow/7.png",
+};
+static const std::array<const char *, FONT_COUNT> font_files = {
+    "Fonts/jupiter_crash.png",
+    "Fonts/Ticketing.ttf",
+    "Fonts/dejavu.png",
+};
+// Cooked sounds are already in the format of the audio device.
+static const std::array<const char *, SOUND_COUNT> sound_files = {
+    "Sound/jump.wav",
+    "Sound/switch1.wav",
+    "Sound/win_sound.wav",
+};
+static const std::array<const char *, MUSIC_COUNT> music_files = {
+    "Music/music.ogg",
+};
+
+// Sprites drawn together are packed onto one atlas page, so they are drawn
+// without switching textures. The pages are listed in texture_atlas.h. The
+// tileset is addressed by tile ids and stays a texture of its own.
+enum class PageId : uint8_t { GAME, END };
+static constexpr size_t PAGE_COUNT = ATLAS_PAGE_COUNT;
+static constexpr size_t NO_PAGE = PAGE_COUNT;
+
+static std::array<Texture2D, PAGE_COUNT> pages;
+// Page of every texture, in handle order.
+static constexpr std::array<size_t, TEXTURE_COUNT> texture_pages = [] {
+  std::array<size_t, TEXTURE_COUNT> result = {};
+  for (size_t i = 0; i < TEXTURE_COUNT; ++i) {
+    result[i] = NO_PAGE;
+    for (const AtlasEntry &entry : ATLAS_ENTRIES) {
+      if (std::string_view(entry.sprite) == texture_files[i]) {
+        result[i] = entry.page;
+      }
+    }
+  }
+  return result;
+}();
+// Where the sprites are on their textures.
+static std::array<Rectangle, TEXTURE_COUNT> sources;
+
+static_assert(static_cast<size_t>(PageId::END) + 1 == PAGE_COUNT);
+static_assert(static_cast<size_t>(TextureId::FIREWORK_7) + 1 == TEXTURE_COUNT);
+static_assert(static_cast<size_t>(FontId::DEJAVU) + 1 == FONT_COUNT);
+static_assert(static_cast<size_t>(SoundId::WIN) + 1 == SOUND_COUNT);
+static_assert(static_cast<size_t>(MusicId::MAIN) + 1 == MUSIC_COUNT);
+// ----------------------------------------------------------------------------------------------------
+
+// ----------------------------------------------------------------------------------------------------
+// Assets are decoded straight from the pack, without one they are loaded from
+// their loose files.
+const AssetPack &get_pack() {
+  static AssetPack pack = [] {
+    AssetPack pack;
+#if defined(INVERSION_EMBED_ASSETS)
+    pack.open(inversion_pack_data, inversion_pack_size);
+#else
+    pack.open("./Assets/Cooked/assets.pack");
+#endif
+    return pack;
+  }();
+  return pack;
+}
+
+// Path of the loose file of an asset, preferring its cooked version.
+static std::string asset_path(const std::string &name) {
+  std::string path = "./Assets/Cooked/" + name;
+  std::error_code error;
+  return std::filesystem::exists(path, error) ? path : "./Assets/" + name;
+}
+
+// Compares the file extension without raylib's text helpers, which share
+// static buffers and are not safe on the decode workers.
+static bool has_extension(std::string_view name, std::string_view extension) {
+  return name.size() >= extension.size() &&
+         name.substr(name.size() - extension.size()) == extension;
+}
+
+static Image load_image(const std::string &name) {
+  if (AssetBlob blob = get_pack().find(name)) {
+    return LoadImageFromMemory(GetFileExtension(name.c_str()), blob.data,
+                               static_cast<int>(blob.size));
+  }
+  return LoadImage(asset_path(name).c_str());
+}
+
+// Text of an asset, empty if there is none.
+static std::string load_text(const std::string &name) {
+  if (AssetBlob blob = get_pack().find(name)) {
+    return std::string(reinterpret_cast<const char *>(blob.data), blob.size);
+  }
+  std::ifstream file(asset_path(name), std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+static Wave load_wave(const std::string &name) {
+  if (AssetBlob blob = get_pack().find(name)) {
+    return LoadWaveFromMemory(GetFileExtension(name.c_str()), blob.data,
+                              static_cast<int>(blob.size));
+  }
+  return LoadWave(asset_path(name).c_str());
+}
+
+// Music is decoded while it plays, from the mapping that outlives it.
+static Music load_music(const std::string &name) {
+  if (AssetBlob blob = get_pack().find(name)) {
+    return LoadMusicStreamFromMemory(GetFileExtension(name.c_str()),
+                                     blob.data, static_cast<int>(blob.size));
+  }
+  return LoadMusicStream(asset_path(name).c_str());
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Asset groups
 // ----------------------------------------------------------------------------------------------------
+enum class AssetKind : uint8_t { TEXTURE, FONT, SOUND, MUSIC, PAGE };
+
+struct AssetKey {
+  AssetKind kind;
+  size_t index;
+};
+
+constexpr AssetKey key(TextureId id) {
+  return {AssetKind::TEXTURE, static_cast<size_t>(id)};
+}
+constexpr AssetKey key(FontId id) {
+  return {AssetKind::FONT, static_cast<size_t>(id)};
+}
+constexpr AssetKey key(SoundId id) {
+  return {AssetKind::SOUND, static_cast<size_t>(id)};
+}
+constexpr AssetKey key(MusicId id) {
+  return {AssetKind::MUSIC, static_cast<size_t>(id)};
+}
+constexpr AssetKey key(PageId id) {
+  return {AssetKind::PAGE, static_cast<size_t>(id)};
+}
+
+// Assets of every group. An asset can belong to several groups.
+struct GroupMember {
+  AssetGroup group;
+  AssetKey asset;
+};
+static constexpr GroupMember group_members[] = {
+    {AssetGroup::COMMON, key(MusicId::MAIN)},
+
+    {AssetGroup::TITLE, key(FontId::DEJAVU)},
+
+    {AssetGroup::MENU, key(FontId::MENU)},
+    {AssetGroup::MENU, key(FontId::LEVEL)},
+
+    {AssetGroup::GAME, key(PageId::GAME)},
+    {AssetGroup::GAME, key(TextureId::TILESET)},
+    {AssetGroup::GAME, key(SoundId::JUMP)},
+    {AssetGroup::GAME, key(SoundId::FLIP)},
+    {AssetGroup::GAME, key(SoundId::WIN)},
+
+    {AssetGroup::END, key(PageId::END)},
+    // Played when the last level is finished.
+    {AssetGroup::END, key(SoundId::WIN)},
+};
+
+static const char *group_names[ASSET_GROUP_COUNT] = {"common", "title", "menu",
+                                                     "game", "end"};
+
+// Residency of an asset. It stays loaded while a group holding it is in use.
+struct Residency {
+  uint32_t refs = 0;
+  bool pending = false;
+  bool resident = false;
+};
+
+// Both tables are trivially destructible, so scopes released during static
+// destruction can still update them.
+static uint32_t group_refs[ASSET_GROUP_COUNT] = {};
+static Residency residency[TEXTURE_COUNT + FONT_COUNT + SOUND_COUNT +
+                           MUSIC_COUNT + PAGE_COUNT] = {};
+
+static Residency &residency_of(AssetKey asset) {
+  switch (asset.kind) {
+  case AssetKind::TEXTURE:
+    return residency[asset.index];
+  case AssetKind::FONT:
+    return residency[TEXTURE_COUNT + asset.index];
+  case AssetKind::SOUND:
+    return residency[TEXTURE_COUNT + FONT_COUNT + asset.index];
+  case AssetKind::MUSIC:
+    return residency[TEXTURE_COUNT + FONT_COUNT + SOUND_COUNT + asset.index];
+  case AssetKind::PAGE:
+  default:
+    return residency[TEXTURE_COUNT + FONT_COUNT + SOUND_COUNT + MUSIC_COUNT +
+                     asset.index];
+  }
+}
+
+static void unload(AssetKey asset) {
+  Residency &state = residency_of(asset);
+  if (!state.resident) {
+    return;
+  }
+  state.resident = false;
+
+  switch (asset.kind) {
+  case AssetKind::TEXTURE:
+    UnloadTexture(textures[asset.index]);
+    textures[asset.index] = {};
+    break;
+  case AssetKind::FONT:
+    UnloadFont(fonts[asset.index]);
+    fonts[asset.index] = {};
+    break;
+  case AssetKind::SOUND:
+    UnloadSound(sounds[asset.index]);
+    sounds[asset.index] = {};
+    break;
+  case AssetKind::MUSIC:
+    UnloadMusicStream(music[asset.index]); // Unload music stream buffers.
+    music[asset.index] = {};
+    break;
+  case AssetKind::PAGE:
+    UnloadTexture(pages[asset.index]);
+    pages[asset.index] = {};
+    for (size_t i = 0; i < TEXTURE_COUNT; ++i) {
+      if (texture_pages[i] == asset.index) {
+        textures[i] = {};
+        sources[i] = {};
+      }
+    }
+    break;
+  }
+}
+
+// Memory held by a loaded asset on the GPU and in the audio buffers.
+static size_t memory_of(AssetKey asset) {
+  if (!residency_of(asset).resident) {
+    return 0;
+  }
+
+  switch (asset.kind) {
+  case AssetKind::TEXTURE: {
+    const Texture2D &texture = textures[asset.index];
+    return GetPixelDataSize(texture.width, texture.height, texture.format);
+  }
+  case AssetKind::FONT: {
+    const Font &font = fonts[asset.index];
+    size_t bytes = GetPixelDataSize(font.texture.width, font.texture.height,
+                                    font.texture.format);
+    for (int i = 0; i < font.glyphCount; ++i) {
+      const Image &glyph = font.glyphs[i].image;
+      bytes += sizeof(GlyphInfo) + sizeof(Rectangle) +
+               GetPixelDataSize(glyph.width, glyph.height, glyph.format);
+    }
+    return bytes;
+  }
+  case AssetKind::SOUND: {
+    const Sound &sound = sounds[asset.index];
+    return static_cast<size_t>(sound.frameCount) * sound.stream.channels *
+           sound.stream.sampleSize / 8;
+  }
+  case AssetKind::PAGE: {
+    const Texture2D &page = pages[asset.index];
+    return GetPixelDataSize(page.width, page.height, page.format);
+  }
+  case AssetKind::MUSIC:
+  default:
+    // Music is streamed from its file or the pack.
+    return 0;
+  }
+}
 
 // ----------------------------------------------------------------------------------------------------
-void load_textures() {
+// Asynchronous loading
+// ----------------------------------------------------------------------------------------------------
+// An asset decoded on a worker thread, waiting to be uploaded on the main
+// thread, which owns the GPU and the audio device.
+struct PendingAsset {
+  AssetKey asset;
+
+  // Pixels of a texture, atlas page or bitmap font, or the glyph atlas of a
+  // TrueType font.
+  Image image = {};
+  // Where the sprites of an atlas page were placed, in handle order.
+  std::vector<Rectangle> sources;
+  // Glyphs of a TrueType font, its texture is created on upload.
+  Font font = {};
+  Wave wave = {};
+
+  std::atomic<bool> decoded{false};
+};
+
+// Assets requested together, decoded by their own workers.
+struct Batch {
+  std::unique_ptr<PendingAsset[]> assets;
+  size_t count = 0;
+  std::atomic<size_t> next_decode{0};
+  size_t next_upload = 0;
+  std::vector<std::future<void>> workers;
+};
+
+// Batches are uploaded in the order they were requested.
+static std::vector<std::unique_ptr<Batch>> batches;
+static std::function<void(float)> on_progress;
+// Assets requested and uploaded since loading was last idle.
+static size_t requested_count = 0;
+static size_t uploaded_count = 0;
+
+// Rasterize the glyphs of a TrueType font the way LoadFont does, leaving out
+// the upload of the glyph atlas.
+static void decode_truetype(const std::string &name, PendingAsset &pending) {
+  const unsigned char *data = nullptr;
+  unsigned char *file = nullptr;
+  int size = 0;
+  if (AssetBlob blob = get_pack().find(name)) {
+    data = blob.data;
+    size = static_cast<int>(blob.size);
+  } else {
+    data = file = LoadFileData(asset_path(name).c_str(), &size);
+  }
+
+  Font &font = pending.font;
+  font.baseSize = 32;
+  font.glyphCount = 95;
+  font.glyphPadding = 4;
+  font.glyphs = LoadFontData(data, size, font.baseSize, nullptr,
+                             font.glyphCount, FONT_DEFAULT);
+  UnloadFileData(file);
+  if (font.glyphs == nullptr) {
+    return;
+  }
+
+  pending.image = GenImageFontAtlas(font.glyphs, &font.recs, font.glyphCount,
+                                    font.baseSize, font.glyphPadding, 0);
+  // Glyph images are cut from the atlas, as ImageDrawText expects them.
+  for (int i = 0; i < font.glyphCount; ++i) {
+    UnloadImage(font.glyphs[i].image);
+    font.glyphs[i].image = ImageFromImage(pending.image, font.recs[i]);
+  }
+}
+
+// Check that the sprites of a page lie within its image.
+static bool covers(const Image &image, const std::vector<Rectangle> &sources) {
+  return std::all_of(sources.begin(), sources.end(), [&](Rectangle source) {
+    return source.x >= 0 && source.y >= 0 &&
+           source.x + source.width <= image.width &&
+           source.y + source.height <= image.height;
+  });
+}
+
+// Load the cooked atlas page, or pack the sprites of the page here if it
+// wasn't cooked or doesn't hold all of them.
+static void decode_page(size_t page, PendingAsset &pending) {
+  std::vector<const char *> names;
+  for (size_t i = 0; i < TEXTURE_COUNT; ++i) {
+    if (texture_pages[i] == page) {
+      names.push_back(texture_files[i]);
+    }
+  }
 
-  auto load_texture = [=](std::string base_path,
-                          std::string file) -> Texture2D {
-    Texture2D texture = LoadTexture((base_path + file).c_str());
+  std::string cooked = ATLAS_PAGES[page];
+  std::string description = load_text(cooked + ".atlas");
+  if (!description.empty() &&
+      read_atlas(description, names, pending.sources)) {
+    pending.image = load_image(cooked + ".png");
+    if (pending.image.data != nullptr &&
+        covers(pending.image, pending.sources)) {
+      return;
+    }
+    UnloadImage(pending.image);
+    pending.image = {};
+  }
+  pending.sources.clear();
+
+  std::vector<AtlasSprite> sprites;
+  for (const char *name : names) {
+    sprites.push_back({load_image(name), {}});
+  }
+
+  pending.image = pack_atlas(sprites);
+  for (auto &sprite : sprites) {
+    pending.sources.push_back(sprite.source);
+    UnloadImage(sprite.image);
+  }
+}
+
+// Runs on a worker thread, only touches CPU memory.
+static void decode(PendingAsset &pending) {
+  size_t index = pending.asset.index;
+  switch (pending.asset.kind) {
+  case AssetKind::TEXTURE:
+    pending.image = load_image(texture_files[index]);
+    break;
+  case AssetKind::FONT:
+    if (has_extension(font_files[index], ".png")) {
+      pending.image = load_image(font_files[index]);
+    } else {
+      decode_truetype(font_files[index], pending);
+    }
+    break;
+  case AssetKind::SOUND:
+    pending.wave = load_wave(sound_files[index]);
+    break;
+  case AssetKind::MUSIC:
+    // Music is streamed, there is nothing to decode up front.
+    break;
+  case AssetKind::PAGE:
+    decode_page(index, pending);
+    break;
+  }
+  pending.decoded.store(true, std::memory_order_release);
+}
+
+// Free the CPU side data of a decoded asset.
+static void discard(PendingAsset &pending) {
+  UnloadImage(pending.image);
+  UnloadWave(pending.wave);
+  if (pending.font.glyphs != nullptr && pending.font.texture.id == 0) {
+    UnloadFontData(pending.font.glyphs, pending.font.glyphCount);
+    MemFree(pending.font.recs);
+  }
+  pending.image = {};
+  pending.wave = {};
+  pending.font = {};
+  pending.sources.clear();
+}
+
+// Runs on the main thread. Assets nobody uses anymore are dropped.
+static void upload(PendingAsset &pending) {
+  Residency &state = residency_of(pending.asset);
+  state.pending = false;
+  if (state.refs == 0) {
+    discard(pending);
+    return;
+  }
+
+  size_t index = pending.asset.index;
+  switch (pending.asset.kind) {
+  case AssetKind::TEXTURE:
+    textures[index] = LoadTextureFromImage(pending.image);
     // Assertion checks if texture has been loaded correctly.
-    assert(texture.id != 0);
-    return texture;
-  };
+    assert(textures[index].id != 0);
+    sources[index] = {0, 0, static_cast<float>(textures[index].width),
+                      static_cast<float>(textures[index].height)};
+    break;
+  case AssetKind::FONT:
+    if (pending.font.glyphs != nullptr) {
+      pending.font.texture = LoadTextureFromImage(pending.image);
+      fonts[index] = pending.font;
+    } else if (pending.image.data != nullptr) {
+      // Bitmap fonts separate their glyphs with magenta, starting at space.
+      fonts[index] = LoadFontFromImage(pending.image, MAGENTA, ' ');
+    } else {
+      fonts[index] = GetFontDefault();
+    }
+    break;
+  case AssetKind::SOUND:
+    sounds[index] = LoadSoundFromWave(pending.wave);
+    break;
+  case AssetKind::MUSIC:
+    music[index] = load_music(music_files[index]);
+    break;
+  case AssetKind::PAGE: {
+    pages[index] = LoadTextureFromImage(pending.image);
+    assert(pages[index].id != 0);
+    auto source = pending.sources.begin();
+    for (size_t i = 0; i < TEXTURE_COUNT; ++i) {
+      if (texture_pages[i] == index) {
+        textures[i] = pages[index];
+        sources[i] = *source++;
+      }
+    }
+    break;
+  }
+  }
+  state.resident = true;
+  discard(pending);
+}
+
+// Queue assets for decoding on worker threads.
+static void load_async(const std::vector<AssetKey> &assets) {
+  auto batch = std::make_unique<Batch>();
+  batch->count = assets.size();
+  batch->assets = std::make_unique<PendingAsset[]>(batch->count);
+  for (size_t i = 0; i < batch->count; ++i) {
+    batch->assets[i].asset = assets[i];
+  }
 
-  std::string sprite_path = "./Assets/Sprites/";
-  std::string emoji_path =
-      "./Assets/Sprites/free-emojis-pixelart/emojis-x2-64x64/";
+  size_t thread_count = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), batch->count);
+  for (size_t i = 0; i < thread_count; ++i) {
+    batch->workers.push_back(
+        std::async(std::launch::async, [batch = batch.get()] {
+          for (size_t next; (next = batch->next_decode++) < batch->count;) {
+            decode(batch->assets[next]);
+          }
+        }));
+  }
+  requested_count += batch->count;
+  batches.push_back(std::move(batch));
+}
+
+// ----------------------------------------------------------------------------------------------------
+void set_progress_callback(std::function<void(float)> callback) {
+  on_progress = std::move(callback);
+}
 
-  textures["happy"] = load_texture(emoji_path, "E17.png");
-  textures["sad"] = load_texture(emoji_path, "E5.png");
-  textures["fear"] = load_texture(emoji_path, "E4.png");
-  textures["vomit"] = load_texture(emoji_path, "E37.png");
-  textures["exhausted"] = load_texture(emoji_path, "E13.png");
+// ----------------------------------------------------------------------------------------------------
+bool update_loading(double budget_seconds) {
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
 
-  textures["armor"] = load_texture(sprite_path, "Armorstand.png");
-  textures["flag"] = load_texture(sprite_path, "flag.png");
+  while (!batches.empty()) {
+    // Upload in request order, so that early requests are available first.
+    Batch &batch = *batches.front();
+    while (batch.next_upload < batch.count) {
+      PendingAsset &pending = batch.assets[batch.next_upload];
+      if (!pending.decoded.load(std::memory_order_acquire)) {
+        return false;
+      }
+      upload(pending);
+      batch.next_upload++;
+      uploaded_count++;
 
-  textures["tileset"] = LoadTexture("./Assets/Sprites/Tiles-and-Enemies.png");
+      if (on_progress) {
+        on_progress(static_cast<float>(uploaded_count) / requested_count);
+      }
+      std::chrono::duration<double> elapsed = clock::now() - start;
+      if (elapsed.count() >= budget_seconds) {
+        return false;
+      }
+    }
+    batches.erase(batches.begin());
 
-  textures["firework_1"] = LoadTexture("./Assets/Sprites/yellow/1.png");
-  textures["firework_2"] = LoadTexture("./Assets/Sprites/yellow/2.png");
-  textures["firework_3"] = LoadTexture("./Assets/Sprites/yellow/3.png");
-  textures["firework_4"] = LoadTexture("./Assets/Sprites/yellow/4.png");
-  textures["firework_5"] = LoadTexture("./Assets/Sprites/yellow/5.png");
-  textures["firework_6"] = LoadTexture("./Assets/Sprites/yellow/6.png");
-  textures["firework_7"] = LoadTexture("./Assets/Sprites/yellow/7.png");
+    if (batches.empty()) {
+      requested_count = uploaded_count = 0;
+      log_memory_report();
+    }
+  }
+  return true;
 }
+
 // ----------------------------------------------------------------------------------------------------
+void cancel_loading() {
+  for (auto &batch : batches) {
+    // Workers stop after the asset they are decoding.
+    batch->next_decode = batch->count;
+    batch->workers.clear();
 
+    for (size_t i = batch->next_upload; i < batch->count; ++i) {
+      residency_of(batch->assets[i].asset).pending = false;
+      discard(batch->assets[i]);
+    }
+  }
+  batches.clear();
+  requested_count = uploaded_count = 0;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Scopes
 // ----------------------------------------------------------------------------------------------------
-Texture2D get_texture(std::string texture_name) {
-  return textures.at(texture_name.c_str());
+static void acquire(AssetGroup group) {
+  if (group_refs[static_cast<size_t>(group)]++ > 0) {
+    return;
+  }
+
+  std::vector<AssetKey> missing;
+  for (const auto &member : group_members) {
+    if (member.group != group) {
+      continue;
+    }
+    Residency &state = residency_of(member.asset);
+    if (state.refs++ == 0 && !state.resident && !state.pending) {
+      state.pending = true;
+      missing.push_back(member.asset);
+    }
+  }
+  if (!missing.empty()) {
+    load_async(missing);
+  }
+}
+
+static void release(AssetGroup group) {
+  if (--group_refs[static_cast<size_t>(group)] > 0) {
+    return;
+  }
+
+  // Assets still being decoded are dropped on upload.
+  bool unloaded = false;
+  for (const auto &member : group_members) {
+    if (member.group != group) {
+      continue;
+    }
+    Residency &state = residency_of(member.asset);
+    if (--state.refs == 0 && state.resident) {
+      unload(member.asset);
+      unloaded = true;
+    }
+  }
+  if (unloaded) {
+    log_memory_report();
+  }
+}
+
+AssetScope::AssetScope(AssetGroup group) : m_Group(group) { acquire(group); }
+
+AssetScope::~AssetScope() { reset(); }
+
+AssetScope::AssetScope(const AssetScope &other) : m_Group(other.m_Group) {
+  if (m_Group) {
+    acquire(*m_Group);
+  }
+}
+
+AssetScope &AssetScope::operator=(const AssetScope &other) {
+  if (this != &other) {
+    // Acquire first, so assets shared with the previous group stay loaded.
+    if (other.m_Group) {
+      acquire(*other.m_Group);
+    }
+    reset();
+    m_Group = other.m_Group;
+  }
+  return *this;
+}
+
+AssetScope::AssetScope(AssetScope &&other) noexcept
+    : m_Group(std::exchange(other.m_Group, std::nullopt)) {}
+
+AssetScope &AssetScope::operator=(AssetScope &&other) noexcept {
+  if (this != &other) {
+    reset();
+    m_Group = std::exchange(other.m_Group, std::nullopt);
+  }
+  return *this;
+}
+
+void AssetScope::reset() {
+  if (m_Group) {
+    release(*std::exchange(m_Group, std::nullopt));
+  }
 }
 
 // ----------------------------------------------------------------------------------------------------
-void unload_textures() {
-  for (auto &texture : textures) {
-    UnloadTexture(texture.second);
+bool is_loaded(AssetGroup group) {
+  for (const auto &member : group_members) {
+    if (member.group == group && !residency_of(member.asset).resident) {
+      return false;
+    }
   }
-  textures.clear();
+  return true;
 }
 
 // ----------------------------------------------------------------------------------------------------
-void load_fonts() {
-  fonts["menu"] = LoadFont("./Assets/Fonts/jupiter_crash.png");
-  fonts["level"] = LoadFont("./Assets/Fonts/Ticketing.ttf");
-  fonts["dejavu"] = LoadFont("./Assets/Fonts/dejavu.png");
+std::vector<GroupMemory> memory_report() {
+  std::vector<GroupMemory> report;
+  for (size_t group = 0; group < ASSET_GROUP_COUNT; ++group) {
+    GroupMemory memory = {static_cast<AssetGroup>(group), 0, 0, 0};
+    for (const auto &member : group_members) {
+      if (member.group != memory.group) {
+        continue;
+      }
+      memory.asset_count++;
+      if (residency_of(member.asset).resident) {
+        memory.resident_count++;
+        memory.bytes += memory_of(member.asset);
+      }
+    }
+    report.push_back(memory);
+  }
+  return report;
+}
+
+void log_memory_report() {
+  size_t total = 0;
+  for (const auto &memory : memory_report()) {
+    TraceLog(LOG_INFO, "ASSETS: [%s] %zu/%zu resident, %.1f KiB",
+             group_names[static_cast<size_t>(memory.group)],
+             memory.resident_count, memory.asset_count, memory.bytes / 1024.0);
+    total += memory.bytes;
+  }
+  TraceLog(LOG_INFO, "ASSETS: %.1f KiB resident in total", total / 1024.0);
 }
 
 // ----------------------------------------------------------------------------------------------------
-Font get_font(std::string font_name) { return fonts[font_name.c_str()]; }
+const Texture2D &get_texture(TextureId texture) {
+  return textures[static_cast<size_t>(texture)];
+}
 
 // ----------------------------------------------------------------------------------------------------
-void unload_fonts() {
-  for (auto &font : fonts) {
-    UnloadFont(font.second);
+Rectangle get_source(TextureId texture) {
+  return sources[static_cast<size_t>(texture)];
+}
+
+Rectangle get_source(TextureId texture, Rectangle part) {
+  Rectangle source = sources[static_cast<size_t>(texture)];
+  return {source.x + part.x, source.y + part.y, part.width, part.height};
+}
+
+// ----------------------------------------------------------------------------------------------------
+void unload_textures() {
+  for (size_t i = 0; i < TEXTURE_COUNT; ++i) {
+    unload({AssetKind::TEXTURE, i});
+  }
+  for (size_t i = 0; i < PAGE_COUNT; ++i) {
+    unload({AssetKind::PAGE, i});
   }
-  fonts.clear();
 }
 
 // ----------------------------------------------------------------------------------------------------
-void load_sounds() {
-  sounds["jump"] = LoadSound("./Assets/Sound/jump.wav");
-  sounds["flip"] = LoadSound("./Assets/Sound/switch1.wav");
-  sounds["win"] = LoadSound("./Assets/Sound/win_sound.wav");
+const Font &get_font(FontId font) { return fonts[static_cast<size_t>(font)]; }
 
-  music["main"] = LoadMusicStream("./Assets/Music/music.ogg");
+// ----------------------------------------------------------------------------------------------------
+void unload_fonts() {
+  for (size_t i = 0; i < FONT_COUNT; ++i) {
+    unload({AssetKind::FONT, i});
+  }
 }
 
 // ----------------------------------------------------------------------------------------------------
-Sound get_sound(std::string sound_name) { return sounds[sound_name.c_str()]; }
+const Sound &get_sound(SoundId sound) {
+  return sounds[static_cast<size_t>(sound)];
+}
 
 // ----------------------------------------------------------------------------------------------------
 void unload_sounds() {
-  for (auto &sound : sounds) {
-    UnloadSound(sound.second);
+  for (size_t i = 0; i < SOUND_COUNT; ++i) {
+    unload({AssetKind::SOUND, i});
   }
-  sounds.clear();
 }
 
 // ----------------------------------------------------------------------------------------------------
-Music get_music(std::string music_name) { return music.at(music_name.c_str()); }
+Music &get_music(MusicId id) { return music[static_cast<size_t>(id)]; }
 
 // ----------------------------------------------------------------------------------------------------
 void unload_music() {
-  for (auto &my_music : music) {
-    UnloadMusicStream(my_music.second); // Unload music stream buffers from RAM.
+  for (size_t i = 0; i < MUSIC_COUNT; ++i) {
+    unload({AssetKind::MUSIC, i});
   }
-  music.clear();
 }
 } // namespace Inversion::AssetManager
@@ -10,40 +10,146 @@
 #pragma once
 
 #include "raylib.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
 #include <string>
+#include <vector>
+
+#include "./asset_pack.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Handles of the game's assets. They index dense arrays, so looking up an
+// asset is a single array access. The files of the assets are listed in the
+// same order in asset_manager.cpp.
+enum class TextureId : uint8_t {
+  HAPPY,
+  SAD,
+  FEAR,
+  VOMIT,
+  EXHAUSTED,
+  ARMOR,
+  FLAG,
+  TILESET,
+  FIREWORK_1,
+  FIREWORK_2,
+  FIREWORK_3,
+  FIREWORK_4,
+  FIREWORK_5,
+  FIREWORK_6,
+  FIREWORK_7,
+};
+constexpr size_t TEXTURE_COUNT = 15;
+
+enum class FontId : uint8_t { MENU, LEVEL, DEJAVU };
+constexpr size_t FONT_COUNT = 3;
+
+enum class SoundId : uint8_t { JUMP, FLIP, WIN };
+constexpr size_t SOUND_COUNT = 3;
+
+enum class MusicId : uint8_t { MAIN };
+constexpr size_t MUSIC_COUNT = 1;
 
-namespace Inversion::AssetManager {
 // ----------------------------------------------------------------------------------------------------
-// Load all textures into memory.
-void load_textures();
+// Groups of assets that are used together. An asset stays loaded while any of
+// its groups is acquired, see AssetManager::AssetScope.
+enum class AssetGroup : uint8_t { COMMON, TITLE, MENU, GAME, END };
+constexpr size_t ASSET_GROUP_COUNT = 5;
 
+namespace AssetManager {
 // ----------------------------------------------------------------------------------------------------
-// Retrieve texture based on unique identifier.
-Texture2D get_texture(std::string texture_name);
+// Pack the assets are loaded from. It is embedded into the executable in
+// EMBED=1 builds, otherwise written by `make cook`. Empty if there is none.
+const AssetPack &get_pack();
 
 // ----------------------------------------------------------------------------------------------------
-// Unload textures.
-void unload_textures();
+// Keeps the assets of a group loaded while it is alive. Missing assets are
+// decoded in the background and uploaded by update_loading. Assets are
+// reference counted, they are unloaded once no scope holds one of their groups.
+class AssetScope {
+public:
+  AssetScope() = default;
+  explicit AssetScope(AssetGroup group);
+  ~AssetScope();
+
+  AssetScope(const AssetScope &other);
+  AssetScope &operator=(const AssetScope &other);
+  AssetScope(AssetScope &&other) noexcept;
+  AssetScope &operator=(AssetScope &&other) noexcept;
+
+  // Release the group early.
+  void reset();
+
+  std::optional<AssetGroup> group() const { return m_Group; }
+
+private:
+  std::optional<AssetGroup> m_Group;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Whether all assets of the group are uploaded.
+bool is_loaded(AssetGroup group);
+
+// ----------------------------------------------------------------------------------------------------
+// The callback is called with the loaded fraction of the assets requested
+// since loading was last idle, after every upload.
+void set_progress_callback(std::function<void(float)> on_progress);
+
+// ----------------------------------------------------------------------------------------------------
+// Upload decoded assets on the main thread for about the given time. Returns
+// true once all requested assets are loaded.
+bool update_loading(double budget_seconds);
+
+// ----------------------------------------------------------------------------------------------------
+// Stop loading and free the assets that haven't been uploaded yet.
+void cancel_loading();
+
+// ----------------------------------------------------------------------------------------------------
+// Memory held by the loaded assets of a group. Assets shared between groups are
+// counted in each of them.
+struct GroupMemory {
+  AssetGroup group;
+  size_t resident_count;
+  size_t asset_count;
+  size_t bytes;
+};
+std::vector<GroupMemory> memory_report();
+
+// ----------------------------------------------------------------------------------------------------
+// Log the memory report, it is also logged when loading finishes and when a
+// group is unloaded.
+void log_memory_report();
+
+// ----------------------------------------------------------------------------------------------------
+// Retrieve texture based on unique identifier. Sprites that are drawn
+// together share a texture atlas page, draw them with their source rectangle.
+const Texture2D &get_texture(TextureId texture);
+
+// ----------------------------------------------------------------------------------------------------
+// Where the sprite is on its texture.
+Rectangle get_source(TextureId texture);
+
+// ----------------------------------------------------------------------------------------------------
+// Where a part of the sprite, given relative to the sprite, is on its texture.
+Rectangle get_source(TextureId texture, Rectangle part);
 
 // ----------------------------------------------------------------------------------------------------
-// Load custom fonts.
-void load_fonts();
+// Unload textures, regardless of the scopes holding them.
+void unload_textures();
 
 // ----------------------------------------------------------------------------------------------------
 // Get a custom font based on unique identifier.
-Font get_font(std::string font_name);
+const Font &get_font(FontId font);
 
 // ----------------------------------------------------------------------------------------------------
 // Unload the font.
 void unload_fonts();
 
-// ----------------------------------------------------------------------------------------------------
-// Load sounds and music into RAM.
-void load_sounds();
-
 // ----------------------------------------------------------------------------------------------------
 // Get sound based on unique identifier.
-Sound get_sound(std::string sound_name);
+const Sound &get_sound(SoundId sound);
 
 // ----------------------------------------------------------------------------------------------------
 // Unload all sounds.
@@ -51,9 +157,10 @@ void unload_sounds();
 
 // ----------------------------------------------------------------------------------------------------
 // Retrieve music by unique identifier.
-Music get_music(std::string music_name);
+Music &get_music(MusicId id);
 
 // ----------------------------------------------------------------------------------------------------
 // Unload music.
 void unload_music();
-} // namespace Inversion::AssetManager
+} // namespace AssetManager
+} // namespace Inversion
@@ -0,0 +1,167 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "./asset_pack.h"
+
+namespace Inversion {
+
+// ----------------------------------------------------------------------------------------------------
+uint64_t asset_hash(std::string_view name) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : name) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+static uint64_t align(uint64_t offset) {
+  return (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool AssetPack::open(const std::string &path) {
+  close();
+  if (!m_File.open(path)) {
+    return false;
+  }
+  if (!read_index(m_File.data(), m_File.size())) {
+    std::cerr << "Invalid asset pack " << path << std::endl;
+    close();
+    return false;
+  }
+
+  // Read the whole pack ahead instead of faulting in every asset on its own.
+  m_File.prefetch();
+  return true;
+}
+
+bool AssetPack::open(const unsigned char *data, size_t size) {
+  close();
+  if (!read_index(data, size)) {
+    std::cerr << "Invalid embedded asset pack" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void AssetPack::close() {
+  m_File.close();
+  m_Data = nullptr;
+  m_Entries = nullptr;
+  m_Count = 0;
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool AssetPack::read_index(const unsigned char *data, size_t size) {
+  if (size < sizeof(PackHeader) ||
+      reinterpret_cast<uintptr_t>(data) % alignof(PackEntry) != 0) {
+    return false;
+  }
+
+  PackHeader header;
+  std::memcpy(&header, data, sizeof(PackHeader));
+  uint64_t index_end =
+      sizeof(PackHeader) + uint64_t{header.entry_count} * sizeof(PackEntry);
+
+  bool valid = std::memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0 &&
+               header.version == PACK_VERSION && header.file_size == size &&
+               index_end <= size;
+
+  const auto *entries =
+      reinterpret_cast<const PackEntry *>(data + sizeof(PackHeader));
+  for (uint32_t i = 0; valid && i < header.entry_count; ++i) {
+    valid = entries[i].offset >= index_end && entries[i].offset <= size &&
+            entries[i].size <= size - entries[i].offset &&
+            (i == 0 || entries[i - 1].name_hash < entries[i].name_hash);
+  }
+  if (!valid) {
+    return false;
+  }
+
+  m_Data = data;
+  m_Entries = entries;
+  m_Count = header.entry_count;
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+AssetBlob AssetPack::find(std::string_view name) const {
+  uint64_t hash = asset_hash(name);
+  const PackEntry *end = m_Entries + m_Count;
+  const PackEntry *entry = std::lower_bound(
+      m_Entries, end, hash,
+      [](const PackEntry &entry, uint64_t hash) {
+        return entry.name_hash < hash;
+      });
+  if (entry == end || entry->name_hash != hash) {
+    return {};
+  }
+  return {m_Data + entry->offset, entry->size, entry->type};
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool write_pack(const std::string &path, std::vector<PackInput> assets) {
+  std::vector<PackEntry> entries(assets.size());
+  for (size_t i = 0; i < assets.size(); ++i) {
+    entries[i] = {asset_hash(assets[i].name), 0, assets[i].data.size(),
+                  assets[i].type, 0};
+  }
+
+  // Keep the blobs in the order of the index, so that a pack is read front
+  // to back when all of its assets are loaded.
+  std::vector<size_t> order(assets.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return entries[a].name_hash < entries[b].name_hash;
+  });
+
+  std::vector<PackEntry> index;
+  uint64_t offset =
+      align(sizeof(PackHeader) + entries.size() * sizeof(PackEntry));
+  for (size_t i : order) {
+    if (!index.empty() && index.back().name_hash == entries[i].name_hash) {
+      std::cerr << "Asset name hash collision on " << assets[i].name
+                << std::endl;
+      return false;
+    }
+    entries[i].offset = offset;
+    offset = align(offset + entries[i].size);
+    index.push_back(entries[i]);
+  }
+
+  PackHeader header = {};
+  std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+  header.version = PACK_VERSION;
+  header.entry_count = static_cast<uint32_t>(index.size());
+  header.file_size = offset;
+
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(index.data()),
+             index.size() * sizeof(PackEntry));
+
+  uint64_t position = sizeof(PackHeader) + index.size() * sizeof(PackEntry);
+  static const char padding[PACK_ALIGNMENT] = {};
+  for (size_t i : order) {
+    file.write(padding, entries[i].offset - position);
+    file.write(reinterpret_cast<const char *>(assets[i].data.data()),
+               assets[i].data.size());
+    position = entries[i].offset + entries[i].size;
+  }
+  file.write(padding, offset - position);
+  return static_cast<bool>(file);
+}
+} // namespace Inversion
@@ -0,0 +1,106 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./mapped_file.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Asset pack format.
+//
+// Layout: [PackHeader][PackEntry * entry_count][blobs]
+// The entries are sorted by the hash of the asset name, which is its path
+// relative to the asset directory (e.g. "Sprites/flag.png"). Every blob
+// starts PACK_ALIGNMENT aligned. The format uses the host byte order (little
+// endian).
+// ----------------------------------------------------------------------------------------------------
+constexpr char PACK_MAGIC[4] = {'I', 'N', 'V', 'P'};
+constexpr uint32_t PACK_VERSION = 1;
+constexpr uint64_t PACK_ALIGNMENT = 16;
+
+// How an asset is decoded.
+enum class AssetType : uint32_t { IMAGE, FONT, SOUND, MUSIC, LEVEL, DATA };
+
+struct PackHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t entry_count;
+  uint32_t reserved;
+  uint64_t file_size;
+};
+
+struct PackEntry {
+  uint64_t name_hash;
+  // Byte offset of the blob relative to the start of the pack.
+  uint64_t offset;
+  uint64_t size;
+  AssetType type;
+  uint32_t reserved;
+};
+
+// 64-bit FNV-1a hash of an asset name.
+uint64_t asset_hash(std::string_view name);
+
+// Bytes of an asset, pointing into the pack.
+struct AssetBlob {
+  const unsigned char *data = nullptr;
+  size_t size = 0;
+  AssetType type = AssetType::DATA;
+
+  explicit operator bool() const { return data != nullptr; }
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Read-only view of an asset pack, either a mapped file or one embedded into
+// the executable. The assets are read in place, they stay valid as long as
+// the pack is open.
+class AssetPack {
+public:
+  AssetPack() = default;
+
+  // Map the pack at the given path, replacing any previously opened pack.
+  bool open(const std::string &path);
+  // Use a pack already in memory, which has to outlive the AssetPack.
+  bool open(const unsigned char *data, size_t size);
+  void close();
+
+  bool is_open() const { return m_Entries != nullptr; }
+  size_t size() const { return m_Count; }
+
+  // Look up an asset by name, returns an empty blob if it isn't packed.
+  AssetBlob find(std::string_view name) const;
+
+private:
+  // Validate the pack and its index.
+  bool read_index(const unsigned char *data, size_t size);
+
+  MappedFile m_File;
+  const unsigned char *m_Data = nullptr;
+  const PackEntry *m_Entries = nullptr;
+  uint32_t m_Count = 0;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Asset to be written into a pack.
+struct PackInput {
+  std::string name;
+  AssetType type;
+  std::vector<unsigned char> data;
+};
+
+// Write a pack holding the given assets. Fails if two names share a hash.
+bool write_pack(const std::string &path, std::vector<PackInput> assets);
+} // namespace Inversion
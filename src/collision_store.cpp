@@ -0,0 +1,110 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "./collision_store.h"
+
+namespace Inversion {
+
+// ----------------------------------------------------------------------------------------------------
+CollisionStore::CollisionStore(std::vector<Rectangle> shapes,
+                               std::vector<uint8_t> flags, float cell_size)
+    : m_Shapes(std::move(shapes)), m_Flags(std::move(flags)),
+      m_CellSize(cell_size) {
+  if (m_Shapes.empty()) {
+    return;
+  }
+
+  // The grid covers the bounding box of all shapes.
+  Vector2 max = m_Origin = {m_Shapes[0].x, m_Shapes[0].y};
+  for (const auto &shape : m_Shapes) {
+    m_Origin.x = std::min(m_Origin.x, shape.x);
+    m_Origin.y = std::min(m_Origin.y, shape.y);
+    max.x = std::max(max.x, shape.x + shape.width);
+    max.y = std::max(max.y, shape.y + shape.height);
+  }
+  m_Columns = static_cast<int32_t>((max.x - m_Origin.x) / m_CellSize) + 1;
+  m_Rows = static_cast<int32_t>((max.y - m_Origin.y) / m_CellSize) + 1;
+
+  // Cells covered by a shape, clamped to the grid.
+  auto cell_range = [&](const Rectangle &shape, int32_t &x0, int32_t &y0,
+                        int32_t &x1, int32_t &y1) {
+    x0 = static_cast<int32_t>((shape.x - m_Origin.x) / m_CellSize);
+    y0 = static_cast<int32_t>((shape.y - m_Origin.y) / m_CellSize);
+    x1 = std::min<int32_t>(
+        (shape.x + shape.width - m_Origin.x) / m_CellSize, m_Columns - 1);
+    y1 = std::min<int32_t>(
+        (shape.y + shape.height - m_Origin.y) / m_CellSize, m_Rows - 1);
+  };
+
+  // Count the shapes per cell first, then fill the cells in shape order so
+  // every cell lists its shapes in ascending order.
+  m_CellStart.assign(static_cast<size_t>(m_Columns) * m_Rows + 1, 0);
+  int32_t x0, y0, x1, y1;
+  for (const auto &shape : m_Shapes) {
+    cell_range(shape, x0, y0, x1, y1);
+    for (int32_t y = y0; y <= y1; ++y) {
+      for (int32_t x = x0; x <= x1; ++x) {
+        m_CellStart[y * m_Columns + x + 1]++;
+      }
+    }
+  }
+  for (size_t i = 1; i < m_CellStart.size(); ++i) {
+    m_CellStart[i] += m_CellStart[i - 1];
+  }
+
+  m_Entries.resize(m_CellStart.back());
+  std::vector<uint32_t> fill(m_CellStart.begin(), m_CellStart.end() - 1);
+  for (uint32_t index = 0; index < m_Shapes.size(); ++index) {
+    cell_range(m_Shapes[index], x0, y0, x1, y1);
+    for (int32_t y = y0; y <= y1; ++y) {
+      for (int32_t x = x0; x <= x1; ++x) {
+        m_Entries[fill[y * m_Columns + x]++] = index;
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+void CollisionStore::query(Rectangle area, std::vector<uint32_t> &result) const {
+  result.clear();
+  if (m_Shapes.empty()) {
+    return;
+  }
+
+  int32_t x0 = std::max<int32_t>(
+      std::floor((area.x - m_Origin.x) / m_CellSize), 0);
+  int32_t y0 = std::max<int32_t>(
+      std::floor((area.y - m_Origin.y) / m_CellSize), 0);
+  int32_t x1 = std::min<int32_t>(
+      std::floor((area.x + area.width - m_Origin.x) / m_CellSize),
+      m_Columns - 1);
+  int32_t y1 = std::min<int32_t>(
+      std::floor((area.y + area.height - m_Origin.y) / m_CellSize),
+      m_Rows - 1);
+
+  for (int32_t y = y0; y <= y1; ++y) {
+    for (int32_t x = x0; x <= x1; ++x) {
+      size_t cell = static_cast<size_t>(y) * m_Columns + x;
+      for (uint32_t i = m_CellStart[cell]; i < m_CellStart[cell + 1]; ++i) {
+        if (CheckCollisionRecs(area, m_Shapes[m_Entries[i]])) {
+          result.push_back(m_Entries[i]);
+        }
+      }
+    }
+  }
+
+  // Shapes spanning several cells are found more than once.
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+} // namespace Inversion
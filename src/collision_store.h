@@ -0,0 +1,56 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Collision shapes of a level, indexed by a uniform grid so that a query only
+// visits the shapes around the queried area instead of the whole level. Each
+// shape carries the LevelFormat::TileFlag bits that define how the player
+// reacts to it.
+class CollisionStore {
+public:
+  // Side length of a grid cell in screen pixels, two tiles.
+  static constexpr float default_cell_size = 128.f;
+
+  CollisionStore() = default;
+  CollisionStore(std::vector<Rectangle> shapes, std::vector<uint8_t> flags,
+                 float cell_size = default_cell_size);
+
+  // Collect the indices of the shapes overlapping an area in ascending order,
+  // replacing the previous contents of result.
+  void query(Rectangle area, std::vector<uint32_t> &result) const;
+
+  const Rectangle &shape(uint32_t index) const { return m_Shapes[index]; }
+  uint8_t flags(uint32_t index) const { return m_Flags[index]; }
+  const std::vector<Rectangle> &shapes() const { return m_Shapes; }
+  const std::vector<uint8_t> &flags() const { return m_Flags; }
+  size_t size() const { return m_Shapes.size(); }
+
+private:
+  std::vector<Rectangle> m_Shapes;
+  std::vector<uint8_t> m_Flags;
+
+  float m_CellSize = default_cell_size;
+  Vector2 m_Origin = {0, 0};
+  int32_t m_Columns = 0;
+  int32_t m_Rows = 0;
+
+  // The shapes overlapping grid cell i are
+  // m_Entries[m_CellStart[i]] ... m_Entries[m_CellStart[i + 1] - 1].
+  std::vector<uint32_t> m_CellStart;
+  std::vector<uint32_t> m_Entries;
+};
+} // namespace Inversion
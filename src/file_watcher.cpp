@@ -0,0 +1,73 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "./file_watcher.h"
+
+namespace Inversion {
+
+#if defined(__linux__)
+// ----------------------------------------------------------------------------------------------------
+FileWatcher::FileWatcher(const std::string &directory) {
+  m_Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_Fd < 0) {
+    return;
+  }
+  // Editors either rewrite the file or move a temporary file over it.
+  if (inotify_add_watch(m_Fd, directory.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    close(m_Fd);
+    m_Fd = -1;
+  }
+}
+
+FileWatcher::~FileWatcher() {
+  if (m_Fd >= 0) {
+    close(m_Fd);
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+std::vector<std::string> FileWatcher::poll() {
+  std::vector<std::string> changed;
+  if (m_Fd < 0) {
+    return changed;
+  }
+
+  alignas(inotify_event) char buffer[4096];
+  ssize_t length;
+  while ((length = read(m_Fd, buffer, sizeof(buffer))) > 0) {
+    for (char *ptr = buffer; ptr < buffer + length;) {
+      auto *event = reinterpret_cast<inotify_event *>(ptr);
+      if (event->len > 0) {
+        std::string name = event->name;
+        if (std::find(changed.begin(), changed.end(), name) == changed.end()) {
+          changed.push_back(std::move(name));
+        }
+      }
+      ptr += sizeof(inotify_event) + event->len;
+    }
+  }
+  return changed;
+}
+#else
+// File watching is only supported on Linux.
+FileWatcher::FileWatcher(const std::string &) {}
+FileWatcher::~FileWatcher() {}
+std::vector<std::string> FileWatcher::poll() { return {}; }
+#endif
+} // namespace Inversion
@@ -0,0 +1,35 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Watches a directory for files that have been written or moved into it.
+// Polling never blocks, so it can be done once per frame.
+class FileWatcher {
+public:
+  explicit FileWatcher(const std::string &directory);
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher &) = delete;
+  FileWatcher &operator=(const FileWatcher &) = delete;
+
+  // Names of the files that changed since the last poll, without duplicates.
+  std::vector<std::string> poll();
+
+  bool is_active() const { return m_Fd >= 0; }
+
+private:
+  int m_Fd = -1;
+};
+} // namespace Inversion
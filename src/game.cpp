@@ -11,6 +11,7 @@
 #include "./asset_manager.h"
 #include "./menu.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -19,6 +20,7 @@ namespace Inversion {
 static int frames_counter = 0;
 // Forward declaration for firework.
 static void draw_fireworks();
+static void draw_sprite(TextureId sprite, int x, int y);
 
 // ----------------------------------------------------------------------------------------------------
 // Inject the dependencies into the object. [Dependency injection]
@@ -26,27 +28,89 @@ Game::Game() : level_selection(&m_Level), m_Player(&m_Level) {}
 
 // ----------------------------------------------------------------------------------------------------
 void Game::init_game() {
+  // Decode the assets in the background, they are uploaded in update_game.
+  // The title screen requests its font first, so it shows up right away.
+  AssetManager::set_progress_callback(
+      [this](float progress) { m_LoadProgress = progress; });
+  set_state(GameState::TITLE);
+  m_CommonAssets = AssetManager::AssetScope(AssetGroup::COMMON);
+
+  // Set player and level properties.
+  m_Level.set_level(0);
+  m_Player.set_rect(m_Level.current_level->spawn, {40, 140});
+}
+
+// ----------------------------------------------------------------------------------------------------
+void Game::set_state(GameState state) {
+  // Asset groups each state needs. The states reachable from a state are
+  // included, so switching to them doesn't wait for their assets. The end
+  // screen can't be left, so the rest of the game is unloaded there.
+  std::vector<AssetGroup> groups;
+  switch (state) {
+  case GameState::TITLE:
+    groups = {AssetGroup::TITLE, AssetGroup::MENU, AssetGroup::GAME};
+    break;
+  case GameState::MENU:
+  case GameState::LEVEL_SELECTION:
+  case GameState::GAME:
+    groups = {AssetGroup::MENU, AssetGroup::GAME};
+    break;
+  case GameState::END:
+    groups = {AssetGroup::END};
+    break;
+  }
+
+  // Acquire the new groups before releasing the old ones, so shared assets
+  // stay loaded.
+  std::vector<AssetManager::AssetScope> scopes;
+  for (AssetGroup group : groups) {
+    scopes.emplace_back(group);
+  }
+  m_StateAssets = std::move(scopes);
+  m_GameState = state;
+}
+
+// ----------------------------------------------------------------------------------------------------
+void Game::on_assets_loaded() {
   // ----------------------------------------------------------------------------------------------------
   // Get game main music and make it loop.
-  m_Music = AssetManager::get_music("main");
+  m_Music = AssetManager::get_music(MusicId::MAIN);
   m_Music.looping = true;
   SetMusicVolume(m_Music, 0.5f);
   // Play this music when the game starts.
   PlayMusicStream(m_Music);
   // ----------------------------------------------------------------------------------------------------
 
-  // Set player and level properties.
-  m_Player.set_rect({200, 820}, {40, 140});
-  m_Level.set_level(0);
   m_Level.set_texture();
 }
 
 // ----------------------------------------------------------------------------------------------------
 void Game::update_game() {
 
+  // Upload a few of the assets decoded in the background every frame, so the
+  // title screen stays responsive while they load. Later state switches may
+  // request more assets.
+  bool idle = AssetManager::update_loading(asset_upload_budget);
+  if (!m_AssetsLoaded) {
+    if (!idle) {
+      return;
+    }
+    m_AssetsLoaded = true;
+    on_assets_loaded();
+  }
+
   // Constantly update the music stream and loop if music finished.
   UpdateMusicStream(m_Music);
 
+  // Pick up levels that have been edited while the game is running.
+  m_Level.reload_changed_levels();
+
+  // The frame time now covers the previous frame, which switched levels.
+  if (m_TransitionPending) {
+    m_TransitionPending = false;
+    m_Level.record_transition_frame(GetFrameTime());
+  }
+
   // ----------------------------------------------------------------------------------------------------
   // Handle input logic.
   // ----------------------------------------------------------------------------------------------------
@@ -55,21 +119,22 @@ void Game::update_game() {
   case GameState::TITLE:
     // Update to Menu when ESC is pressed.
     if (IsKeyPressed(KEY_ESCAPE)) {
-      m_GameState = GameState::MENU;
+      set_state(GameState::MENU);
     }
     // Update to the first level if any other key is pressed.
     else if (GetKeyPressed()) {
-      m_GameState = GameState::GAME;
+      set_state(GameState::GAME);
     }
     break;
   // ----------------------------------------------------------------------------------------------------
   case GameState::GAME:
     if (IsKeyPressed(KEY_ESCAPE)) {
-      m_GameState = GameState::MENU;
+      set_state(GameState::MENU);
     }
     m_Player.move();
+    m_Level.update_streaming(m_Player.get_position());
     if (m_Level.finished) {
-      m_GameState = GameState::END;
+      set_state(GameState::END);
     }
     break;
   // ----------------------------------------------------------------------------------------------------
@@ -82,12 +147,15 @@ void Game::update_game() {
     // Proceed with the game.
     if (main_menu.m_ShouldResume) {
       main_menu.m_ShouldResume = false;
-      m_GameState = GameState::GAME;
+      set_state(GameState::GAME);
     }
 
     // Move in the level selection state.
     else if (main_menu.m_ShouldLevelSelect) {
-      m_GameState = GameState::LEVEL_SELECTION;
+      // Any level can be picked from here. Load the ones around the current
+      // level in the background, as many as the cache holds.
+      m_Level.preload_around(m_Level.m_Id);
+      set_state(GameState::LEVEL_SELECTION);
     }
 
     // Quit the application if the user signals it.
@@ -101,16 +169,16 @@ void Game::update_game() {
 
     // Go back to menu if ESCAPE key has been pressed.
     if (IsKeyPressed(KEY_ESCAPE)) {
-      m_GameState = GameState::MENU;
+      set_state(GameState::MENU);
       main_menu.m_ShouldLevelSelect = false;
     }
 
     level_selection.handle_input();
     if (level_selection.mouse_pressed) {
       level_selection.mouse_pressed = false;
-      m_Player.set_position({200, 820});
+      m_Player.set_position(m_Level.current_level->spawn);
       main_menu.m_ShouldLevelSelect = false;
-      m_GameState = GameState::GAME;
+      set_state(GameState::GAME);
     }
     break;
   // ----------------------------------------------------------------------------------------------------
@@ -121,6 +189,43 @@ void Game::update_game() {
     break;
   }
   // ----------------------------------------------------------------------------------------------------
+
+  // Remember level switches so the next frame can report their duration.
+  if (m_Level.m_Id != m_LevelId) {
+    m_LevelId = m_Level.m_Id;
+    m_TransitionPending = true;
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+void Game::unload_game() { m_Level.unload_textures(); }
+
+// ----------------------------------------------------------------------------------------------------
+void Game::update_camera() {
+  const Rectangle &bounds = m_Level.current_level->bounds;
+  Rectangle player = m_Player.get_rect();
+  Vector2 screen = {static_cast<float>(GetScreenWidth()),
+                    static_cast<float>(GetScreenHeight())};
+
+  auto follow = [](float target, float start, float size, float screen) {
+    if (size <= screen) {
+      return start + size / 2;
+    }
+    return std::clamp(target, start + screen / 2, start + size - screen / 2);
+  };
+  m_Camera.offset = {screen.x / 2, screen.y / 2};
+  m_Camera.target = {
+      follow(player.x + player.width / 2, bounds.x, bounds.width, screen.x),
+      follow(player.y + player.height / 2, bounds.y, bounds.height,
+             screen.y)};
+  m_Camera.rotation = 0.f;
+  m_Camera.zoom = 1.f;
+}
+
+Rectangle Game::camera_view() const {
+  Vector2 top_left = GetScreenToWorld2D({0, 0}, m_Camera);
+  return {top_left.x, top_left.y, GetScreenWidth() / m_Camera.zoom,
+          GetScreenHeight() / m_Camera.zoom};
 }
 
 // ----------------------------------------------------------------------------------------------------
@@ -133,13 +238,24 @@ void Game::draw_game() {
   // Draw the title screen.
   case GameState::TITLE:
 
-    // Draw text with custom font.
+    // Draw text with custom font. Fonts are loaded first, the other assets
+    // may still be loading.
     ClearBackground(BLACK);
-    DrawTextEx(AssetManager::get_font("dejavu"), "INVERSION", {220, 300}, 200,
-               20, WHITE);
-    DrawTextEx(AssetManager::get_font("dejavu"), "PRESS ANY BUTTON",
-               {800, 1000}, 30, 5, WHITE);
+    if (AssetManager::get_font(FontId::DEJAVU).texture.id != 0) {
+      DrawTextEx(AssetManager::get_font(FontId::DEJAVU), "INVERSION",
+                 {220, 300}, 200, 20, WHITE);
+    }
     DrawText("by Johannes Elsing", 1170, 500, 20, WHITE);
+
+    if (m_AssetsLoaded) {
+      DrawTextEx(AssetManager::get_font(FontId::DEJAVU), "PRESS ANY BUTTON",
+                 {800, 1000}, 30, 5, WHITE);
+    } else {
+      // Loading bar.
+      DrawRectangleLines(800, 1000, 320, 30, WHITE);
+      DrawRectangle(800, 1000, static_cast<int>(320 * m_LoadProgress), 30,
+                    WHITE);
+    }
     break;
   // ----------------------------------------------------------------------------------------------------
   // Draw the game main menu.
@@ -154,11 +270,18 @@ void Game::draw_game() {
     break;
   // ----------------------------------------------------------------------------------------------------
   // Draw the current level and player.
-  case GameState::GAME:
+  case GameState::GAME: {
     ClearBackground(BLACK);
-    m_Level.draw_level();
+    // The window may have been resized, so the camera is placed here.
+    update_camera();
+    Rectangle view = camera_view();
+    BeginMode2D(m_Camera);
+    m_Level.draw_level(view);
     m_Player.draw();
+    m_Level.draw_foreground(view);
+    EndMode2D();
     break;
+  }
   // ----------------------------------------------------------------------------------------------------
   case GameState::END:
     ClearBackground(BLUE);
@@ -168,26 +291,33 @@ void Game::draw_game() {
   }
 }
 
+// Draw a sprite from its atlas page.
+void draw_sprite(TextureId sprite, int x, int y) {
+  DrawTextureRec(AssetManager::get_texture(sprite),
+                 AssetManager::get_source(sprite),
+                 {static_cast<float>(x), static_cast<float>(y)}, WHITE);
+}
+
 // Draw fireworks for the end screen.
 void draw_fireworks() {
   if (frames_counter < 10) {
-    DrawTexture(AssetManager::get_texture("firework_1"), 600, 200, WHITE);
-    DrawTexture(AssetManager::get_texture("firework_1"), 1100, 200, WHITE);
+    draw_sprite(TextureId::FIREWORK_1, 600, 200);
+    draw_sprite(TextureId::FIREWORK_1, 1100, 200);
   } else if (frames_counter < 20 && frames_counter <= 30) {
-    DrawTexture(AssetManager::get_texture("firework_2"), 600, 200, WHITE);
-    DrawTexture(AssetManager::get_texture("firework_2"), 1100, 200, WHITE);
+    draw_sprite(TextureId::FIREWORK_2, 600, 200);
+    draw_sprite(TextureId::FIREWORK_2, 1100, 200);
   } else if (frames_counter < 30 && frames_counter <= 40) {
-    DrawTexture(AssetManager::get_texture("firework_3"), 600, 200, WHITE);
-    DrawTexture(AssetManager::get_texture("firework_3"), 1100, 200, WHITE);
+    draw_sprite(TextureId::FIREWORK_3, 600, 200);
+    draw_sprite(TextureId::FIREWORK_3, 1100, 200);
   } else if (frames_counter < 40 && frames_counter <= 50) {
-    DrawTexture(AssetManager::get_texture("firework_4"), 600, 200, WHITE);
-    DrawTexture(AssetManager::get_texture("firework_4"), 1100, 200, WHITE);
+    draw_sprite(TextureId::FIREWORK_4, 600, 200);
+    draw_sprite(TextureId::FIREWORK_4, 1100, 200);
   } else if (frames_counter < 50 && frames_counter <= 60) {
-    DrawTexture(AssetManager::get_texture("firework_5"), 600, 200, WHITE);
-    DrawTexture(AssetManager::get_texture("firework_5"), 1100, 200, WHITE);
+    draw_sprite(TextureId::FIREWORK_5, 600, 200);
+    draw_sprite(TextureId::FIREWORK_5, 1100, 200);
   } else if (frames_counter < 60 && frames_counter <= 70) {
-    DrawTexture(AssetManager::get_texture("firework_6"), 600, 200, WHITE);
-    DrawTexture(AssetManager::get_texture("firework_6"), 1100, 200, WHITE);
+    draw_sprite(TextureId::FIREWORK_6, 600, 200);
+    draw_sprite(TextureId::FIREWORK_6, 1100, 200);
   }
   frames_counter++;
   // Reset frame counter to see animation periodically
@@ -9,12 +9,15 @@
 
 #pragma once
 
+#include "./asset_manager.h"
 #include "./level.h"
 #include "./main_menu.h"
 #include "./player.h"
 
 #include "raylib.h"
 
+#include <vector>
+
 namespace Inversion {
 
 // Define the three major game states.
@@ -35,20 +38,55 @@ public:
   // Draw the main game loop.
   void draw_game();
 
+  // Free what the game created on the GPU, before the window is closed.
+  void unload_game();
+
   // Used to signal when the application should terminate and clean itself up.
   bool m_Quit = false;
 
 private:
+  // Switch the game state, keeping only the assets it needs loaded.
+  void set_state(GameState state);
+
+  // Set up what depends on the assets once they are loaded.
+  void on_assets_loaded();
+
+  // Center the camera on the player, keeping the view within the level.
+  // Levels smaller than the screen are centered.
+  void update_camera();
+
+  // Area of the level the camera shows.
+  Rectangle camera_view() const;
+
+  // Time per frame spent uploading assets while they load.
+  static constexpr double asset_upload_budget = 0.004;
+
   // Define a game-state variable with initial value TITLE.
   GameState m_GameState = GameState::TITLE;
 
   // Store the music for the game and set desired properties.
   Music m_Music;
 
+  // Assets load while the title screen is shown.
+  bool m_AssetsLoaded = false;
+  float m_LoadProgress = 0.f;
+
+  // Asset groups used in every state and in the current one.
+  AssetManager::AssetScope m_CommonAssets;
+  std::vector<AssetManager::AssetScope> m_StateAssets;
+
+  // Follows the player through the level.
+  Camera2D m_Camera = {};
+
+  // Set when the level changed, to measure the frame it happened in.
+  int m_LevelId = 0;
+  bool m_TransitionPending = false;
+
   // Create instances of the classes to merge game logic together.
+  // The level manager comes first since the other members depend on it.
+  LevelManager m_Level;
   MainMenu main_menu;
   LevelSelection level_selection;
-  LevelManager m_Level;
   Player m_Player;
 };
 } // namespace Inversion
@@ -8,161 +8,776 @@
 // Author: Johannes Elsing <je305@students.uni-freiburg.de>
 
 // STL
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
 #include <cmath>
-#include <fstream>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
-#include <map>
+#include <memory>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
-#include "json.hpp"
 #include "raylib.h"
 
 #include "./asset_manager.h"
+#include "./asset_pack.h"
 #include "./level.h"
+#include "./level_format.h"
+#include "./level_stream.h"
+#include "./mapped_file.h"
+#include "./tile_builder.h"
 
-using json = nlohmann::json;
+namespace fs = std::filesystem;
 
 namespace Inversion {
 
-LevelManager::LevelManager() {
-  // Load and extract all levels.
-  for (int i = 0; i < 16; ++i) {
-    load_and_extract(i,
-                     "./Assets/JSON/level_" + std::to_string(i + 1) + ".tmj");
+// Tiled maps used for authoring and their compiled runtime counterparts.
+static const std::string source_directory = "./Assets/JSON";
+
+static std::string source_path(int level_id) {
+  return "./Assets/JSON/level_" + std::to_string(level_id + 1) + ".tmj";
+}
+
+static std::string binary_path(int level_id) {
+  return "./Assets/Levels/level_" + std::to_string(level_id + 1) + ".lvl";
+}
+
+#if defined(INVERSION_EMBED_ASSETS)
+// Name of a compiled level in the asset pack.
+static std::string packed_name(int level_id) {
+  return "Levels/level_" + std::to_string(level_id + 1) + ".lvl";
+}
+#endif
+
+// Map a Tiled file name back to its level id, or -1 if it isn't a level.
+static int level_id_from_name(const std::string &name) {
+  int number = 0;
+  char extension[5] = {};
+  if (std::sscanf(name.c_str(), "level_%d.%4s", &number, extension) != 2 ||
+      std::string(extension) != "tmj") {
+    return -1;
   }
-  // Set the current level to the first level.
-  m_Id = 0;
-  current_level = levels.at(m_Id);
+  return number - 1;
 }
 
-LevelManager::~LevelManager() {}
+// ----------------------------------------------------------------------------------------------------
+// Infinite levels keep their chunks in a store and are built piece by piece
+// while the player moves through them.
+static TileMapping stream_level(std::shared_ptr<const ChunkStore> store) {
+  const LevelFormat::LevelView &view = store->view();
+  const LevelFormat::Header &header = view.header;
+
+  TileMapping level;
+  for (uint32_t layer = 0; layer < header.layer_count; ++layer) {
+    level.layer_roles.push_back(view.layers[layer].role);
+  }
+  level.animations = build_animations(view);
+  level.collision = std::make_shared<CollisionStore>(
+      std::vector<Rectangle>(view.shapes, view.shapes + header.shape_count),
+      std::vector<uint8_t>(header.shape_count, LevelFormat::TILE_SOLID));
+  level.flag_coords = {header.flag_x, header.flag_y};
+  level.flag_flipped = false;
+  level.spawn = {header.spawn_x, header.spawn_y};
+  level.columns = header.width;
+  level.rows = header.height;
+  level.geometry = tile_geometry(header);
+
+  // The chunks may lie anywhere around the origin.
+  float chunk_width = header.chunk_size * level.geometry.screen_tile_size.x;
+  float chunk_height = header.chunk_size * level.geometry.screen_tile_size.y;
+  for (uint32_t chunk = 0; chunk < header.chunk_count; ++chunk) {
+    Rectangle area = {view.chunks[chunk].x * level.geometry.screen_tile_size.x,
+                      view.chunks[chunk].y * level.geometry.screen_tile_size.y,
+                      chunk_width, chunk_height};
+    if (chunk == 0) {
+      level.bounds = area;
+      continue;
+    }
+    float right = std::max(level.bounds.x + level.bounds.width,
+                           area.x + area.width);
+    float bottom = std::max(level.bounds.y + level.bounds.height,
+                            area.y + area.height);
+    level.bounds.x = std::min(level.bounds.x, area.x);
+    level.bounds.y = std::min(level.bounds.y, area.y);
+    level.bounds.width = right - level.bounds.x;
+    level.bounds.height = bottom - level.bounds.y;
+  }
+  level.chunks = std::move(store);
+  return level;
+}
+
+// Build a level from a validated compiled level. The file keeps the memory
+// of the view alive, it is empty for levels embedded into the executable.
+static TileMapping build_level(MappedFile file,
+                               const LevelFormat::LevelView &view) {
+  if (view.header.chunk_size > 0) {
+    return stream_level(std::make_shared<ChunkStore>(std::move(file), view));
+  }
+  return build_tile_mapping(view);
+}
+
+// Build a level from a parsed Tiled map.
+static TileMapping build_level(LevelFormat::LevelData data) {
+  if (data.header.chunk_size > 0) {
+    return stream_level(std::make_shared<ChunkStore>(std::move(data)));
+  }
+  return build_tile_mapping(data.view());
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Mark the fill tiles of a parsed Tiled map and refresh its compiled binary.
+// The tileset pixels are decoded by the caller, they are null if the image
+// couldn't be read.
+static void finish_level(int level_id, LevelFormat::LevelData &data,
+                         const Image *tileset) {
+  // Mark the tiles of a single colour, their runs are drawn merged. The
+  // image has to cover every tile of the map, or the wrong pixels would be
+  // compared.
+  const LevelFormat::Header &header = data.header;
+  size_t rows = (data.tile_flags.size() + header.tileset_columns - 1) /
+                header.tileset_columns;
+  if (tileset != nullptr &&
+      static_cast<size_t>(tileset->width) >=
+          size_t(header.tileset_columns) * header.tile_width &&
+      static_cast<size_t>(tileset->height) >= rows * header.tile_height) {
+    LevelFormat::mark_fill_tiles(data,
+                                 static_cast<const Color *>(tileset->data),
+                                 tileset->width, tileset->height);
+  } else if (!data.tileset_image.empty()) {
+    TraceLog(LOG_WARNING, "LEVEL: [%d] Tileset %s doesn't fit the map",
+             level_id + 1, data.tileset_image.c_str());
+  }
+
+  // Refresh the compiled level so the next start skips the JSON parse.
+  std::string binary = binary_path(level_id);
+  std::error_code error;
+  fs::create_directories(fs::path(binary).parent_path(), error);
+  if (!LevelFormat::write_binary(binary, data)) {
+    std::cerr << "Could not write compiled level " << binary << std::endl;
+  }
+}
+
+// Run job(i) for every index below count on up to one thread per core. Each
+// thread takes the next index until none are left. Returns the number of
+// threads used.
+template <typename Job> static size_t parallel_for(size_t count, Job job) {
+  std::atomic<size_t> next = 0;
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++) {
+      job(i);
+    }
+  };
+
+  size_t thread_count = std::min<size_t>(
+      std::max(1u, std::thread::hardware_concurrency()), count);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return thread_count;
+}
+
+LevelManager::LevelManager(size_t cache_capacity)
+    : levels(cache_capacity), m_Id(0) {
+  // Count the available levels, they are loaded on demand.
+#if defined(INVERSION_EMBED_ASSETS)
+  while (AssetManager::get_pack().find(packed_name(m_LevelCount))) {
+    m_LevelCount++;
+  }
+#else
+  std::error_code error;
+  while (fs::exists(source_path(m_LevelCount), error) ||
+         fs::exists(binary_path(m_LevelCount), error)) {
+    m_LevelCount++;
+  }
+  m_Watcher = std::make_unique<FileWatcher>(source_directory);
+#endif
+}
+
+LevelManager::~LevelManager() {
+  // The prefetch worker may still be decoding a tileset.
+  if (m_Prefetch.valid()) {
+    m_Prefetch.wait();
+  }
+  for (auto &[path, image] : m_Tilesets) {
+    UnloadImage(image);
+  }
+}
 
 void LevelManager::set_texture() {
-  this->tileset = Inversion::AssetManager::get_texture("tileset");
+  this->tileset = Inversion::AssetManager::get_texture(TextureId::TILESET);
+  // The meshes hold texture coordinates on the previous tileset.
+  for (auto &layers : m_StaticLayers) {
+    layers.dirty = true;
+  }
 }
 
-void LevelManager::load_and_extract(int level_id, const std::string &path) {
-  std::ifstream file(path);
-  assert(file.is_open());
+void LevelManager::unload_textures() {
+  for (auto &layers : m_StaticLayers) {
+    layers.tile_map.unload();
+    for (auto &mesh : layers.meshes) {
+      mesh.unload();
+    }
+    layers.level_id = -1;
+    layers.level.reset();
+    layers.dirty = true;
+    layers.use_tile_map = false;
+  }
+  m_TileMapTried = m_TileMapSupported = false;
+}
 
-  json level_data = json::parse(file);
+// ----------------------------------------------------------------------------------------------------
+bool LevelManager::load_compiled(int level_id, TileMapping &level) {
+#if defined(INVERSION_EMBED_ASSETS)
+  // Embedded builds read their levels from the executable only.
+  AssetBlob blob = AssetManager::get_pack().find(packed_name(level_id));
+  LevelFormat::LevelView view;
+  if (!blob || !LevelFormat::read_binary(blob.data, blob.size, view)) {
+    return false;
+  }
+  level = build_level(MappedFile(), view);
+  return true;
+#else
+  std::string source = source_path(level_id);
+  std::string binary = binary_path(level_id);
+
+  // Use the compiled level unless the Tiled map has been edited since.
+  std::error_code error;
+  bool binary_current = fs::exists(binary, error);
+  if (binary_current && fs::exists(source, error)) {
+    binary_current =
+        fs::last_write_time(binary, error) >= fs::last_write_time(source, error);
+  }
+  return binary_current && load_binary(binary, level);
+#endif
+}
 
-  TileMapping level;
+// ----------------------------------------------------------------------------------------------------
+bool LevelManager::load_level(int level_id, TileMapping &level) {
+  if (load_compiled(level_id, level)) {
+    return true;
+  }
+#if defined(INVERSION_EMBED_ASSETS)
+  // There are no Tiled maps to fall back to.
+  return false;
+#else
+  return load_and_extract(level_id, source_path(level_id), level);
+#endif
+}
 
-  // Extract tile info from JSON
-  int tile_width = level_data["tilewidth"];
-  int tile_height = level_data["tileheight"];
+// ----------------------------------------------------------------------------------------------------
+bool LevelManager::load_and_extract(int level_id, const std::string &path,
+                                    TileMapping &level) {
+  LevelFormat::LevelData data;
+  if (!compile_level(level_id, path, data)) {
+    return false;
+  }
+  level = build_level(std::move(data));
+  return true;
+}
 
-  // TileMap and screen have a 1:4 ratio.
-  float screen_tile_width = 4 * tile_width;
-  float screen_tile_height = 4 * tile_height;
+// ----------------------------------------------------------------------------------------------------
+bool LevelManager::compile_level(int level_id, const std::string &path,
+                                 LevelFormat::LevelData &data) {
+  if (!LevelFormat::parse_tmj(path, data)) {
+    return false;
+  }
+  finish_level(level_id, data, tileset_pixels(data.tileset_image));
+  return true;
+}
 
-  int tileset_width =
-      static_cast<int>(level_data["tilesets"][0]["imagewidth"]) / tile_width;
+// ----------------------------------------------------------------------------------------------------
+const Image *LevelManager::tileset_pixels(const std::string &path) {
+  if (path.empty()) {
+    return nullptr;
+  }
+  // Decoding only touches the CPU side of raylib, which is safe on any
+  // thread. The lock keeps two workers from decoding the same image.
+  std::lock_guard<std::mutex> lock(m_TilesetMutex);
+  // Images that failed to load are kept empty so they aren't retried.
+  auto found = m_Tilesets.find(path);
+  if (found == m_Tilesets.end()) {
+    Image image = LoadImage(path.c_str());
+    if (image.data != nullptr) {
+      ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    }
+    found = m_Tilesets.emplace(path, image).first;
+  }
+  return found->second.data != nullptr ? &found->second : nullptr;
+}
 
-  int width = static_cast<int>(level_data["layers"][0]["width"]);
-  int height = static_cast<int>(level_data["layers"][0]["height"]);
+// ----------------------------------------------------------------------------------------------------
+bool LevelManager::load_binary(const std::string &path, TileMapping &level) {
+  MappedFile file;
+  LevelFormat::LevelView view;
+  if (!LevelFormat::map_binary(path, file, view)) {
+    return false;
+  }
+  level = build_level(std::move(file), view);
+  return true;
+}
 
-  for (auto row = 0; row < height; ++row) {
-    for (auto col = 0; col < width; ++col) {
+// ----------------------------------------------------------------------------------------------------
+LevelHandle LevelManager::get_level(int level_id) {
+  // Wait for a level that is already being prefetched instead of loading it
+  // a second time.
+  collect_prefetch(is_prefetching(level_id));
 
-      int index = row * width + col;
+  if (auto level = levels.find(level_id)) {
+    return level;
+  }
 
-      // Retrieve the global tile id from the JSON file.
-      unsigned gid = level_data["layers"][0]["data"][index];
+  // Failed loads aren't cached, the next request tries again.
+  auto level = std::make_shared<TileMapping>();
+  if (!load_level(level_id, *level)) {
+    TraceLog(LOG_ERROR, "LEVEL: [%d] Could not be loaded", level_id + 1);
+    return nullptr;
+  }
 
-      // Extract the global ID and adjust for Tiled's 1-based indexing.
-      unsigned i = (gid & 0x0fffffff) - 1;
+  return levels.insert(level_id, std::move(level));
+}
 
-      // Compute (x, y) position in world space.
-      float x = (i % tileset_width) * tile_width;
-      float y = (i / tileset_width) * tile_height;
+// ----------------------------------------------------------------------------------------------------
+TileMapping &LevelManager::edit_level(int level_id) {
+  LevelHandle source =
+      level_id == m_Id ? current_level : levels.peek(level_id);
+  assert(source && "Only loaded levels can be edited");
+  assert(!source->chunks && "Streamed levels can't be edited");
+
+  auto level = std::make_shared<TileMapping>(*source);
+  levels.insert(level_id, level);
+  if (level_id == m_Id) {
+    current_level = level;
+  }
+  // The caller modifies the level after this returns.
+  for (auto &layers : m_StaticLayers) {
+    if (layers.level_id == level_id) {
+      layers.dirty = true;
+    }
+  }
+  return *level;
+}
 
-      // Compute the destination rectangle coordinates.
-      float dest_x = col * screen_tile_width;
-      float dest_y = row * screen_tile_height;
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::reload_changed_levels() {
+  if (!m_Watcher) {
+    return;
+  }
+  for (const auto &name : m_Watcher->poll()) {
+    int level_id = level_id_from_name(name);
+    if (level_id >= 0 && level_id < m_LevelCount) {
+      reload_level(level_id);
+    }
+  }
+}
 
-      float curr_tile_width = tile_width;
-      float curr_tile_height = tile_height;
+// ----------------------------------------------------------------------------------------------------
+bool LevelManager::reload_level(int level_id) {
+  // A prefetched copy would be stale, let it land in the cache to patch it.
+  collect_prefetch(is_prefetching(level_id));
 
-      // Determine how the tile is flipped by extracting bits.
-      bool flipped_horizontally = gid & 0x80000000;
-      bool flipped_vertically = gid & 0x40000000;
-      bool flipped_diagonally = gid & 0x20000000;
+  LevelFormat::LevelData data;
+  if (!compile_level(level_id, source_path(level_id), data)) {
+    return false;
+  }
 
-      if (flipped_horizontally)
-        curr_tile_width *= -1;
-      if (flipped_vertically)
-        curr_tile_height *= -1;
+  // Levels that aren't loaded pick up the refreshed binary on their next use.
+  bool loaded =
+      (level_id == m_Id && current_level) || levels.contains(level_id);
+  if (!loaded) {
+    return true;
+  }
 
-      float rotation = 0.f;
+  // Streamed levels swap their chunk store and rebuild the resident chunks
+  // that changed.
+  LevelHandle previous = levels.peek(level_id);
+  bool streamed = data.header.chunk_size > 0 ||
+                  (previous && previous->chunks) ||
+                  (level_id == m_Id && m_Stream.is_active());
+  if (streamed) {
+    auto level = std::make_shared<TileMapping>();
+    if (data.header.chunk_size > 0) {
+      *level = stream_level(std::make_shared<ChunkStore>(std::move(data)));
+    } else {
+      *level = build_tile_mapping(data.view());
+    }
+    levels.insert(level_id, level);
 
-      if (flipped_diagonally) {
-        rotation = 90.f;
-        curr_tile_width *= -1;
-        dest_x += screen_tile_width;
+    if (level_id == m_Id) {
+      if (m_Stream.is_active() && level->chunks) {
+        m_Stream.replace(level);
+      } else {
+        m_Stream.reset(level, current_level->spawn);
       }
+      current_level = m_Stream.is_active() ? m_Stream.assemble() : level;
+    }
+    TraceLog(LOG_INFO, "LEVEL: [%d] Reloaded streamed level", level_id + 1);
+    return true;
+  }
 
-      // Compute the cooordinates for the source rectangle.
-      level.rects.push_back(
-          {dest_x, dest_y, screen_tile_width, screen_tile_height});
-      level.coords.push_back({x, y});
-      level.width.push_back(curr_tile_width);
-      level.height.push_back(curr_tile_height);
-      level.rotation.push_back(rotation);
+  TileMapping &level = edit_level(level_id);
+  size_t changed = patch_tile_mapping(level, data.view());
 
-      if (flipped_diagonally) {
-        dest_x -= screen_tile_width;
-      }
+  TraceLog(LOG_INFO, "LEVEL: [%d] Reloaded, %zu tiles changed", level_id + 1,
+           changed);
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::select_batch(const std::vector<int> &level_ids,
+                                std::vector<int> &batch,
+                                std::vector<int> &pending) const {
+  // Only as many levels as the cache holds are loaded, more would just
+  // evict the start of the batch again.
+  for (int level_id : level_ids) {
+    if (batch.size() == levels.capacity()) {
+      break;
+    }
+    if (std::find(batch.begin(), batch.end(), level_id) != batch.end()) {
+      continue;
+    }
+    batch.push_back(level_id);
+    if (!levels.contains(level_id)) {
+      pending.push_back(level_id);
+    }
+  }
+}
 
-      /*
-       * TODO:
-       * Instead of checking individual tiles that are hard-coded,
-       * I should use an object-layer for collisions and check against that.
-       * I also shouldn't store collision rects in a vector but rather
-       * compute the player collisions based on the position at runtime.
-       */
-      if (i == 15 || i == 41 || i == 55 || i == 66 || i == 68 || i == 132 ||
-          i == 131 || i == 148 || i == 146 || i == 144 || i == 159 ||
-          i == 257 || i == 84 || i == 70 || i == 283 || i == 133 || i == 417 ||
-          i == 418 || i == 392 || i == 391 || i == 247 || i == 274 ||
-          i == 223) {
-        level.collision_rects.push_back(
-            {dest_x, dest_y, screen_tile_width, screen_tile_height});
+// ----------------------------------------------------------------------------------------------------
+std::vector<std::shared_ptr<TileMapping>>
+LevelManager::load_batch(const std::vector<int> &level_ids,
+                         std::vector<LevelLoadTiming> &timings) {
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+
+  std::vector<std::shared_ptr<TileMapping>> loaded(level_ids.size());
+  timings.assign(level_ids.size(), {});
+
+  // Each result has its own slot, so no further synchronization is needed.
+  size_t thread_count = parallel_for(level_ids.size(), [&](size_t i) {
+    auto level_start = clock::now();
+    auto level = std::make_shared<TileMapping>();
+    bool success = load_level(level_ids[i], *level);
+    if (success) {
+      loaded[i] = std::move(level);
+    }
+    std::chrono::duration<double, std::milli> elapsed =
+        clock::now() - level_start;
+    timings[i] = {level_ids[i], success, elapsed.count()};
+  });
+
+  std::chrono::duration<double, std::milli> total = clock::now() - start;
+  for (const auto &timing : timings) {
+    TraceLog(timing.loaded ? LOG_INFO : LOG_WARNING,
+             "LEVEL: [%d] %s in %.2f ms", timing.level_id + 1,
+             timing.loaded ? "Loaded" : "Failed to load", timing.milliseconds);
+  }
+  TraceLog(LOG_INFO, "LEVEL: Loaded %zu levels on %zu threads in %.2f ms",
+           level_ids.size(), thread_count, total.count());
+  return loaded;
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::merge_batch(
+    const std::vector<int> &batch, const std::vector<int> &pending,
+    std::vector<std::shared_ptr<TileMapping>> loaded) {
+  // Merge in request order so the cache state doesn't depend on scheduling.
+  // Levels of the batch that were already cached are touched as well, so
+  // the new ones don't evict them.
+  for (size_t i = 0, j = 0; i < batch.size(); ++i) {
+    if (j < pending.size() && pending[j] == batch[i]) {
+      if (loaded[j]) {
+        levels.insert(pending[j], std::move(loaded[j]));
       }
+      ++j;
+    } else {
+      levels.find(batch[i]);
     }
   }
+}
 
-  // Always set the flag to the same coords.
-  level.flag_coords = {1780, 380};
-  level.flag_flipped = false;
+// ----------------------------------------------------------------------------------------------------
+std::vector<LevelLoadTiming>
+LevelManager::preload(const std::vector<int> &level_ids) {
+  // Don't load a prefetched level concurrently a second time.
+  collect_prefetch(true);
+
+  std::vector<int> batch;
+  std::vector<int> pending;
+  select_batch(level_ids, batch, pending);
 
-  // Assign the level-map a key-value pair [level_id -> level].
-  levels[level_id] = level;
+  std::vector<LevelLoadTiming> timings;
+  merge_batch(batch, pending, load_batch(pending, timings));
+  return timings;
 }
 
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::preload_around(int level_id) {
+  // Nearest levels first, the next one before the previous one.
+  std::vector<int> level_ids;
+  for (int distance = 0; distance < m_LevelCount; ++distance) {
+    if (level_id + distance < m_LevelCount) {
+      level_ids.push_back(level_id + distance);
+    }
+    if (distance > 0 && level_id - distance >= 0) {
+      level_ids.push_back(level_id - distance);
+    }
+  }
+
+  // A running prefetch only loads a single level or is part of an earlier
+  // batch around the same level, wait for it instead of skipping the batch.
+  collect_prefetch(true);
+
+  std::vector<int> batch;
+  std::vector<int> pending;
+  select_batch(level_ids, batch, pending);
+
+  // The nearest levels are merged last, so they are evicted last.
+  std::reverse(batch.begin(), batch.end());
+  std::reverse(pending.begin(), pending.end());
+  start_prefetch(std::move(batch), std::move(pending));
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::prefetch(int level_id) {
+  if (level_id < 0 || level_id >= m_LevelCount || levels.contains(level_id)) {
+    return;
+  }
+  start_prefetch({level_id}, {level_id});
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::start_prefetch(std::vector<int> batch,
+                                  std::vector<int> pending) {
+  // Never block the game on an unrelated prefetch that is still running.
+  collect_prefetch(false);
+  if (m_Prefetch.valid()) {
+    return;
+  }
+  if (pending.empty()) {
+    merge_batch(batch, pending, {});
+    return;
+  }
+
+  m_PrefetchBatch = std::move(batch);
+  m_PrefetchPending = pending;
+  m_Prefetch = std::async(std::launch::async,
+                          [this, pending = std::move(pending)]() {
+                            std::vector<LevelLoadTiming> timings;
+                            return load_batch(pending, timings);
+                          });
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool LevelManager::is_prefetching(int level_id) const {
+  return std::find(m_PrefetchPending.begin(), m_PrefetchPending.end(),
+                   level_id) != m_PrefetchPending.end();
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::collect_prefetch(bool wait) {
+  if (!m_Prefetch.valid()) {
+    return;
+  }
+  if (!wait && m_Prefetch.wait_for(std::chrono::seconds(0)) !=
+                   std::future_status::ready) {
+    return;
+  }
+
+  merge_batch(m_PrefetchBatch, m_PrefetchPending, m_Prefetch.get());
+  m_PrefetchBatch.clear();
+  m_PrefetchPending.clear();
+}
+
+// ----------------------------------------------------------------------------------------------------
 void LevelManager::set_level(int level_id) {
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+
+  bool ready = levels.contains(level_id) || is_prefetching(level_id);
+  LevelHandle level = get_level(level_id);
+  if (!level) {
+    if (!current_level) {
+      TraceLog(LOG_FATAL, "LEVEL: No level to start with");
+    }
+    TraceLog(LOG_WARNING, "LEVEL: Staying on level %d", m_Id + 1);
+    return;
+  }
   m_Id = level_id;
-  current_level = levels.at(m_Id);
+  current_level = std::move(level);
+
+  // Infinite levels start out with the chunks around the spawn point.
+  m_Stream.reset(current_level, current_level->spawn);
+  if (m_Stream.is_active()) {
+    current_level = m_Stream.assemble();
+  }
+
+  std::chrono::duration<double, std::milli> elapsed = clock::now() - start;
+  m_Transition = {level_id, ready, elapsed.count(), 0};
+
+  // Progression is linear, so the next level is known in advance.
+  prefetch(m_Id + 1);
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::record_transition_frame(float frame_time) {
+  m_Transition.frame_milliseconds = frame_time * 1000.0;
+  TraceLog(LOG_INFO,
+           "LEVEL: Switched to level %d in %.3f ms (%s), frame took %.2f ms",
+           m_Transition.level_id + 1, m_Transition.switch_milliseconds,
+           m_Transition.prefetched ? "prefetched" : "loaded on demand",
+           m_Transition.frame_milliseconds);
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelManager::update_streaming(Vector2 position) {
+  if (m_Stream.update(position)) {
+    current_level = m_Stream.assemble();
+  }
+}
+
+// Animated tiles were unpacked when the static layers were updated, only
+// their frame is looked up here.
+void LevelManager::draw_animated(Rectangle view) {
+  const StaticLayers &layers = m_StaticLayers[m_CurrentStatic];
+  if (!layers.level) {
+    return;
+  }
+  const TileMapping &level = *layers.level;
+  double time = GetTime();
+
+  auto draw_tile = [&](const StaticLayers::AnimatedTile &tile) {
+    const TileEntry &entry = tile.entry;
+    Vector2 coords = entry.coords;
+    if (tile.animation >= 0) {
+      const TileAnimation &animation = level.animations[tile.animation];
+      float offset = std::fmod(time, animation.length);
+      size_t frame = 0;
+      while (frame + 1 < animation.durations.size() &&
+             offset >= animation.durations[frame]) {
+        offset -= animation.durations[frame++];
+      }
+      coords = animation.coords[frame];
+    }
+
+    DrawTexturePro(tileset, {coords.x, coords.y, entry.width, entry.height},
+                   entry.rect, {0, 0}, entry.rotation, WHITE);
+  };
+
+  layers.animated_blocks.for_each_visible(
+      view, level.geometry.screen_tile_size,
+      [&](uint32_t first, uint32_t count) {
+        for (uint32_t i = first; i < first + count; ++i) {
+          draw_tile(layers.animated_tiles[i]);
+        }
+      });
 }
 
-// Draw the current level.
-void LevelManager::draw_level() {
+// Update the tile map or meshes of the static layers, and the blocks of the
+// animated layer. Edits keep the layout of the level, so only the changed
+// cells or tiles are uploaded.
+void LevelManager::update_static_layers() {
+  // Switch to the layers of the current level. A new level takes the place
+  // of the one drawn before the current one.
+  if (m_StaticLayers[m_CurrentStatic].level_id != m_Id) {
+    m_CurrentStatic = (m_CurrentStatic + 1) % m_StaticLayers.size();
+    StaticLayers &other = m_StaticLayers[m_CurrentStatic];
+    if (other.level_id != m_Id) {
+      other.level_id = m_Id;
+      other.dirty = true;
+    }
+  }
+
+  StaticLayers &layers = m_StaticLayers[m_CurrentStatic];
+  if ((!layers.dirty && current_level == layers.level) || tileset.id == 0) {
+    return;
+  }
+  if (!m_TileMapTried) {
+    m_TileMapTried = true;
+    m_TileMapSupported = layers.tile_map.load();
+  }
+
+  // The resident chunks of streamed levels change as the player moves.
+  bool use_tile_map = m_TileMapSupported && !m_Stream.is_active();
+  if (use_tile_map) {
+    layers.tile_map.load();
+    layers.tile_map.update(*current_level);
+  } else {
+    layers.tile_map.unload();
+  }
+  for (auto role :
+       {TileMapping::LayerRole::BACKGROUND, TileMapping::LayerRole::COLLIDABLE,
+        TileMapping::LayerRole::FOREGROUND}) {
+    TileMesh &mesh = layers.meshes[static_cast<size_t>(role)];
+    if (use_tile_map) {
+      mesh.unload();
+    } else {
+      mesh.update(current_level->batch(role), current_level->geometry,
+                  tileset);
+    }
+  }
 
-  for (size_t i = 0; i < current_level.coords.size(); ++i) {
-    DrawTexturePro(tileset,
-                   {current_level.coords[i].x, current_level.coords[i].y,
-                    current_level.width[i], current_level.height[i]},
-                   {current_level.rects[i].x, current_level.rects[i].y,
-                    current_level.rects[i].width,
-                    current_level.rects[i].height},
-                   {0, 0}, current_level.rotation[i], WHITE);
+  const TileMapping &level = *current_level;
+  const TileBatch &animated = level.batch(TileMapping::LayerRole::ANIMATED);
+  layers.animated_blocks.build(animated);
+  layers.animated_tiles.clear();
+  for (uint32_t index : layers.animated_blocks.order()) {
+    const PackedTile &tile = animated.tiles[index];
+    auto animation = std::lower_bound(
+        level.animations.begin(), level.animations.end(), tile.id(),
+        [](const TileAnimation &animation, uint32_t tile_id) {
+          return animation.tile_id < tile_id;
+        });
+    bool found = animation != level.animations.end() &&
+                 animation->tile_id == tile.id() && animation->length > 0;
+    layers.animated_tiles.push_back(
+        {make_tile(level.geometry, tile),
+         found ? static_cast<int32_t>(animation - level.animations.begin())
+               : -1});
   }
 
-  DrawTexturePro(
-      Inversion::AssetManager::get_texture("flag"), {0, 0, 16, 16},
-      {current_level.flag_coords.x, current_level.flag_coords.y, 64, 64},
-      {0, 0}, 0, WHITE);
+  layers.use_tile_map = use_tile_map;
+  layers.level = current_level;
+  layers.dirty = false;
+}
+
+void LevelManager::draw_static_layer(TileMapping::LayerRole role,
+                                     Rectangle view) {
+  const StaticLayers &layers = m_StaticLayers[m_CurrentStatic];
+  if (layers.use_tile_map) {
+    layers.tile_map.draw(role, tileset, view);
+  } else {
+    layers.meshes[static_cast<size_t>(role)].draw(tileset, view);
+  }
+}
+
+// Draw the current level behind the player.
+void LevelManager::draw_level(Rectangle view) {
+  const TileMapping &level = *current_level;
+
+  update_static_layers();
+  draw_static_layer(TileMapping::LayerRole::BACKGROUND, view);
+  draw_static_layer(TileMapping::LayerRole::COLLIDABLE, view);
+  draw_animated(view);
+
+  DrawTexturePro(Inversion::AssetManager::get_texture(TextureId::FLAG),
+                 Inversion::AssetManager::get_source(TextureId::FLAG,
+                                                     {0, 0, 16, 16}),
+                 {level.flag_coords.x, level.flag_coords.y, 64, 64}, {0, 0},
+                 0, WHITE);
+}
+
+// Draw the foreground layers in front of the player.
+void LevelManager::draw_foreground(Rectangle view) {
+  draw_static_layer(TileMapping::LayerRole::FOREGROUND, view);
 }
 } // namespace Inversion
@@ -9,46 +9,225 @@
 
 #pragma once
 #include "raylib.h"
-#include <map>
+#include <cstddef>
+#include <array>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <unordered_set>
+#include <unordered_map>
 #include <vector>
 
+#include "./file_watcher.h"
+#include "./level_cache.h"
+#include "./level_stream.h"
+#include "./tile_blocks.h"
+#include "./tile_map.h"
+#include "./tile_mapping.h"
+#include "./tile_mesh.h"
+
 namespace Inversion {
 // ----------------------------------------------------------------------------------------------------
-// Handle the level core functionality like drawing and initialization.
-struct TileMapping {
-  std::vector<Rectangle> rects;
-  std::vector<Rectangle> collision_rects;
-  std::vector<Vector2> coords;
-  std::vector<float> rotation;
-  std::vector<float> width;
-  std::vector<float> height;
-  std::vector<int> gids;
-
-  bool flag_flipped;
-  Rectangle flag_coords;
+// Load time of a single level, reported by batch loads.
+struct LevelLoadTiming {
+  int level_id;
+  bool loaded;
+  double milliseconds;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Timing of the most recent level switch.
+struct LevelTransition {
+  int level_id = -1;
+  // Whether the level was ready (cached or prefetched) when requested.
+  bool prefetched = false;
+  // Time spent inside set_level().
+  double switch_milliseconds = 0;
+  // Duration of the whole frame in which the switch happened.
+  double frame_milliseconds = 0;
 };
 
+// ----------------------------------------------------------------------------------------------------
+// Handle the level core functionality like drawing and initialization.
 class LevelManager {
 public:
-  LevelManager();
+  // Number of levels kept in memory at once by default.
+  static constexpr size_t default_cache_capacity = 8;
+
+  explicit LevelManager(size_t cache_capacity = default_cache_capacity);
   ~LevelManager();
 
-  void load_and_extract(int level_id, const std::string &path);
-  void draw_level();
+  // Load a level, preferring the compiled binary over the Tiled source.
+  // Safe to call from any thread, it doesn't touch the GL context.
+  bool load_level(int level_id, TileMapping &level);
+
+  // Parse a Tiled map (authoring path) and refresh its compiled binary.
+  bool load_and_extract(int level_id, const std::string &path,
+                        TileMapping &level);
+
+  // Map a compiled level. Returns false if it is missing or invalid.
+  static bool load_binary(const std::string &path, TileMapping &level);
+
+  // Retrieve a level from the cache, loading it on a miss. Returns nullptr
+  // if the level can't be loaded.
+  LevelHandle get_level(int level_id);
+
+  // Copy-on-write access to a cached level. The level is copied before it
+  // is handed out for modification, so handles held elsewhere keep their
+  // unmodified snapshot. Infinite levels are streamed and can't be edited.
+  TileMapping &edit_level(int level_id);
+  TileMapping &edit_current_level() { return edit_level(m_Id); }
+
+  // Reload levels whose Tiled maps changed on disk. Only the tiles that
+  // differ are rebuilt and the current level is updated in place, so the
+  // player keeps its position.
+  void reload_changed_levels();
+  bool reload_level(int level_id);
+
+  // Load a batch of levels in parallel and add them to the cache in the
+  // given order. The cache bound is kept, so only the first levels that fit
+  // are loaded. Levels that are already cached are skipped. Blocks until the
+  // batch is loaded.
+  std::vector<LevelLoadTiming> preload(const std::vector<int> &level_ids);
+
+  // Load the levels closest to the given one on a background thread, as
+  // many as the cache holds. For screens from which any level can be picked.
+  void preload_around(int level_id);
+
+  // Start loading a level on a background thread. It is added to the cache
+  // the next time a level is requested. Only one prefetch runs at a time.
+  void prefetch(int level_id);
+
+  // Record the duration of the frame in which the level was switched.
+  void record_transition_frame(float frame_time);
+  const LevelTransition &last_transition() const { return m_Transition; }
+
+  // Number of levels found in the asset directories.
+  int level_count() const { return m_LevelCount; }
+
+  void set_cache_capacity(size_t capacity) { levels.set_capacity(capacity); }
+  const LevelCache::Stats &cache_stats() const { return levels.stats(); }
+
+  // Stream the chunks of an infinite level around the player. Does nothing
+  // for finite levels.
+  void update_streaming(Vector2 position);
+
+  // Draw the level behind the player and the foreground layers in front.
+  // Only the tiles that overlap the view are drawn.
+  void draw_level(Rectangle view);
+  void draw_foreground(Rectangle view);
 
   void set_texture();
   void set_level(int level_id);
 
+  // Free the tile map and meshes. Has to be called while the window is open.
+  void unload_textures();
+
   // These variables provide a public interface because they
   // have to be acessed from third-party locations.
-  TileMapping current_level;
-  std::map<int, TileMapping> levels;
+  LevelHandle current_level;
+  LevelCache levels;
   int m_Id;
   bool finished = false;
 
 private:
+  // Pick the levels of a batch that fit into the cache, and the ones among
+  // them that aren't cached yet.
+  void select_batch(const std::vector<int> &level_ids, std::vector<int> &batch,
+                    std::vector<int> &pending) const;
+
+  // Load levels in parallel and log their timings. Failed levels are null.
+  // Safe to call from any thread.
+  std::vector<std::shared_ptr<TileMapping>>
+  load_batch(const std::vector<int> &level_ids,
+             std::vector<LevelLoadTiming> &timings);
+
+  // Add the loaded pending levels of a batch to the cache in batch order.
+  void merge_batch(const std::vector<int> &batch,
+                   const std::vector<int> &pending,
+                   std::vector<std::shared_ptr<TileMapping>> loaded);
+
+  // Load the pending levels of a batch on a background thread, unless a
+  // prefetch is still running.
+  void start_prefetch(std::vector<int> batch, std::vector<int> pending);
+  bool is_prefetching(int level_id) const;
+
+  // Move a finished prefetch into the cache. If wait is set, block until a
+  // running prefetch finishes.
+  void collect_prefetch(bool wait);
+
+  // Map a compiled level. Fails if it is missing or older than its Tiled
+  // map.
+  static bool load_compiled(int level_id, TileMapping &level);
+
+  // Parse a Tiled map, mark its fill tiles and refresh its compiled binary.
+  bool compile_level(int level_id, const std::string &path,
+                     LevelFormat::LevelData &data);
+
+  // Tileset image in RGBA, decoded on first use. Returns nullptr if it can't
+  // be read. Safe to call from any thread.
+  const Image *tileset_pixels(const std::string &path);
+
+  // Draw the animated tiles in view, showing the frame of the current time.
+  void draw_animated(Rectangle view);
+
+  // Upload the static layers of the current level into the tile map or the
+  // tile meshes if it changed since they were updated.
+  void update_static_layers();
+  void draw_static_layer(TileMapping::LayerRole role, Rectangle view);
+
   Texture2D tileset;
+  int m_LevelCount = 0;
+
+  // Decoded tileset images by path, used to find the fill tiles when a
+  // Tiled map is compiled. Prefetch and preload workers compile levels
+  // concurrently, so the images are guarded by the mutex.
+  std::unordered_map<std::string, Image> m_Tilesets;
+  std::mutex m_TilesetMutex;
+
+  // Notifies about edited Tiled maps for hot-reloading. Embedded builds run
+  // without the Assets directory and have none.
+  std::unique_ptr<FileWatcher> m_Watcher;
+
+  // Levels loaded in the background and the batch they are merged into the
+  // cache with.
+  std::future<std::vector<std::shared_ptr<TileMapping>>> m_Prefetch;
+  std::vector<int> m_PrefetchBatch;
+  std::vector<int> m_PrefetchPending;
+  LevelTransition m_Transition;
+
+  // Resident chunks of the current level if it is infinite.
+  LevelStream m_Stream;
+
+  // Finite levels draw their static layers with the tile map shader. Streamed
+  // levels, and drivers without support for the shader, draw vertex buffers
+  // indexed by layer role. The animated layer is drawn tile by tile, grouped
+  // by block to skip the tiles out of view.
+  struct StaticLayers {
+    int level_id = -1;
+    // Level the layers show. Edits and reloads replace the level, only the
+    // copy handed out by edit_level() is modified in place.
+    LevelHandle level;
+    bool dirty = true;
+    TileMap tile_map;
+    bool use_tile_map = false;
+    std::array<TileMesh, LevelFormat::LAYER_ROLE_COUNT> meshes;
+    TileBlocks animated_blocks;
+    // Draw arguments of the animated tiles in block order. They are drawn
+    // every frame, so they are unpacked once here. The animation is an
+    // index into the animations of the level, -1 if the tile has none.
+    struct AnimatedTile {
+      TileEntry entry;
+      int32_t animation;
+    };
+    std::vector<AnimatedTile> animated_tiles;
+  };
+  // The uploaded layers of the current and the previously drawn level. They
+  // are only rebuilt when their level is edited or reloaded, switching back
+  // to the previous level draws it without uploading it again.
+  std::array<StaticLayers, 2> m_StaticLayers;
+  size_t m_CurrentStatic = 0;
+  bool m_TileMapTried = false;
+  bool m_TileMapSupported = false;
 };
 } // namespace Inversion
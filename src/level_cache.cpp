@@ -0,0 +1,82 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include <algorithm>
+#include <utility>
+
+#include "./level_cache.h"
+
+namespace Inversion {
+
+// ----------------------------------------------------------------------------------------------------
+LevelCache::LevelCache(size_t capacity)
+    : m_Capacity(std::max<size_t>(capacity, 1)) {}
+
+// ----------------------------------------------------------------------------------------------------
+std::shared_ptr<TileMapping> LevelCache::find(int level_id) {
+  auto it = m_Index.find(level_id);
+  if (it == m_Index.end()) {
+    m_Stats.misses++;
+    return nullptr;
+  }
+  m_Stats.hits++;
+
+  // Move the entry to the front without reallocating it.
+  m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+  return it->second->second;
+}
+
+// ----------------------------------------------------------------------------------------------------
+std::shared_ptr<TileMapping>
+LevelCache::insert(int level_id, std::shared_ptr<TileMapping> level) {
+  auto it = m_Index.find(level_id);
+  if (it != m_Index.end()) {
+    it->second->second = std::move(level);
+    m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+    return it->second->second;
+  }
+
+  // Make room for the new entry first.
+  evict_to(m_Capacity - 1);
+
+  m_Entries.emplace_front(level_id, std::move(level));
+  m_Index[level_id] = m_Entries.begin();
+  return m_Entries.front().second;
+}
+
+// ----------------------------------------------------------------------------------------------------
+std::shared_ptr<TileMapping> LevelCache::peek(int level_id) const {
+  auto it = m_Index.find(level_id);
+  return it == m_Index.end() ? nullptr : it->second->second;
+}
+
+bool LevelCache::contains(int level_id) const {
+  return m_Index.find(level_id) != m_Index.end();
+}
+
+void LevelCache::clear() {
+  m_Entries.clear();
+  m_Index.clear();
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelCache::set_capacity(size_t capacity) {
+  m_Capacity = std::max<size_t>(capacity, 1);
+  evict_to(m_Capacity);
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelCache::evict_to(size_t size) {
+  while (m_Entries.size() > size) {
+    m_Index.erase(m_Entries.back().first);
+    m_Entries.pop_back();
+    m_Stats.evictions++;
+  }
+}
+} // namespace Inversion
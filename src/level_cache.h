@@ -0,0 +1,66 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "./tile_mapping.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Size-bounded cache of loaded levels. When full, the least recently used
+// level is evicted to make room for a new one.
+class LevelCache {
+public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+  };
+
+  explicit LevelCache(size_t capacity);
+
+  // Look up a level and mark it as most recently used. Returns nullptr (and
+  // counts a miss) if the level is not cached.
+  std::shared_ptr<TileMapping> find(int level_id);
+
+  // Insert or replace a level, evicting the least recently used ones if the
+  // cache is full. Evicted levels stay alive while they are still in use.
+  std::shared_ptr<TileMapping> insert(int level_id,
+                                      std::shared_ptr<TileMapping> level);
+
+  // Look up a level without updating the recency order or the stats.
+  std::shared_ptr<TileMapping> peek(int level_id) const;
+
+  bool contains(int level_id) const;
+  void clear();
+
+  void set_capacity(size_t capacity);
+  size_t capacity() const { return m_Capacity; }
+  size_t size() const { return m_Entries.size(); }
+
+  const Stats &stats() const { return m_Stats; }
+
+private:
+  void evict_to(size_t size);
+
+  // Entries ordered from most to least recently used.
+  using Entry = std::pair<int, std::shared_ptr<TileMapping>>;
+  std::list<Entry> m_Entries;
+  std::unordered_map<int, std::list<Entry>::iterator> m_Index;
+
+  size_t m_Capacity;
+  Stats m_Stats;
+};
+} // namespace Inversion
@@ -0,0 +1,1317 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+// STL
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "json.hpp"
+#include <zlib.h>
+
+#if defined(INVERSION_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+#include "./level_format.h"
+
+using json = nlohmann::json;
+
+namespace Inversion::LevelFormat {
+
+// Default spawn and goal used by maps that don't specify their own.
+static constexpr Vector2 default_spawn = {200, 820};
+static constexpr Vector2 default_flag = {1780, 380};
+
+// ----------------------------------------------------------------------------------------------------
+uint8_t default_tile_flags(unsigned tile_id) {
+  switch (tile_id) {
+  case 15:
+  case 41:
+  case 55:
+  case 66:
+  case 68:
+  case 70:
+  case 84:
+  case 131:
+  case 132:
+  case 133:
+  case 144:
+  case 146:
+  case 148:
+  case 159:
+  case 223:
+  case 247:
+  case 257:
+  case 274:
+  case 283:
+  case 391:
+  case 392:
+  case 417:
+  case 418:
+    return TILE_SOLID;
+  default:
+    return 0;
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Decode base64 text into the given buffer. Returns the number of bytes
+// written, or -1 if the text is invalid or doesn't fit.
+static long decode_base64(const std::string &text, uint8_t *out,
+                          size_t capacity) {
+  static constexpr auto table = [] {
+    std::array<int8_t, 256> table{};
+    for (auto &value : table)
+      value = -1;
+    const char *alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 64; ++i)
+      table[static_cast<uint8_t>(alphabet[i])] = static_cast<int8_t>(i);
+    return table;
+  }();
+
+  size_t written = 0;
+  uint32_t buffer = 0;
+  int bits = 0;
+
+  for (char c : text) {
+    if (c == '=')
+      break;
+    int8_t value = table[static_cast<uint8_t>(c)];
+    if (value < 0) {
+      // Tiled may wrap the text, skip the whitespace.
+      if (c == '\n' || c == '\r' || c == ' ')
+        continue;
+      return -1;
+    }
+    buffer = (buffer << 6) | static_cast<uint32_t>(value);
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      if (written == capacity)
+        return -1;
+      out[written++] = static_cast<uint8_t>(buffer >> bits);
+    }
+  }
+  return static_cast<long>(written);
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Inflate a zlib or gzip stream into the given buffer.
+static bool inflate_into(const uint8_t *data, size_t size, uint8_t *out,
+                         size_t out_size) {
+  z_stream stream{};
+  // 32 + MAX_WBITS accepts both zlib and gzip headers.
+  if (inflateInit2(&stream, 32 + MAX_WBITS) != Z_OK) {
+    return false;
+  }
+
+  stream.next_in = const_cast<Bytef *>(data);
+  stream.avail_in = static_cast<uInt>(size);
+  stream.next_out = out;
+  stream.avail_out = static_cast<uInt>(out_size);
+
+  int result = inflate(&stream, Z_FINISH);
+  bool complete = result == Z_STREAM_END && stream.total_out == out_size;
+  inflateEnd(&stream);
+  return complete;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Decode a base64 tile layer, optionally compressed, straight into the
+// given gids, which have room for tile_count tiles.
+static bool decode_layer(const std::string &text,
+                         const std::string &compression, size_t tile_count,
+                         uint32_t *gids) {
+  size_t byte_count = tile_count * sizeof(uint32_t);
+  uint8_t *out = reinterpret_cast<uint8_t *>(gids);
+
+  bool decoded = false;
+  if (compression.empty()) {
+    decoded = decode_base64(text, out, byte_count) ==
+              static_cast<long>(byte_count);
+  } else {
+    std::vector<uint8_t> compressed(text.size() / 4 * 3 + 3);
+    long size = decode_base64(text, compressed.data(), compressed.size());
+
+    if (size < 0) {
+      decoded = false;
+    } else if (compression == "zlib" || compression == "gzip") {
+      decoded = inflate_into(compressed.data(), size, out, byte_count);
+    } else if (compression == "zstd") {
+#if defined(INVERSION_WITH_ZSTD)
+      size_t result = ZSTD_decompress(out, byte_count, compressed.data(), size);
+      decoded = !ZSTD_isError(result) && result == byte_count;
+#else
+      std::cerr << "Build with ZSTD=1 to load zstd compressed levels"
+                << std::endl;
+#endif
+    } else {
+      std::cerr << "Unknown tile layer compression " << compression
+                << std::endl;
+    }
+  }
+
+  if (!decoded) {
+    std::cerr << "Could not decode tile layer" << std::endl;
+    return false;
+  }
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  // Tiled stores the gids in little endian order.
+  for (size_t tile = 0; tile < tile_count; ++tile) {
+    gids[tile] = __builtin_bswap32(gids[tile]);
+  }
+#endif
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Tile properties and animations of a tileset, embedded or external.
+struct Tileset {
+  // Image path relative to the file declaring the tileset.
+  std::string image;
+  uint32_t image_width = 0;
+  uint32_t tile_count = 0;
+
+  // Set if any tile has properties, even if none of them is a flag.
+  bool has_properties = false;
+  std::vector<uint8_t> flags;
+  std::vector<AnimationFrame> frames;
+
+  void add_flags(uint32_t tile_id, uint8_t tile_flags) {
+    if (tile_id >= flags.size()) {
+      flags.resize(tile_id + 1, 0);
+    }
+    flags[tile_id] |= tile_flags;
+  }
+};
+
+// Flag set by a boolean tile property.
+static uint8_t tile_flag(const std::string &name) {
+  if (name == "solid")
+    return TILE_SOLID;
+  if (name == "hazard")
+    return TILE_HAZARD;
+  if (name == "one_way")
+    return TILE_ONE_WAY;
+  if (name == "gravity_flip")
+    return TILE_GRAVITY_FLIP;
+  return 0;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Read an external Tiled tileset (.tsx). Tiled writes a small and regular
+// subset of XML, so the tags are scanned directly instead of pulling in an
+// XML parser.
+static bool parse_tsx(const std::string &path, Tileset &tileset) {
+  MappedFile file(path);
+  if (!file.is_open()) {
+    std::cerr << "Could not open tileset " << path << std::endl;
+    return false;
+  }
+
+  const char *text = reinterpret_cast<const char *>(file.data());
+  const char *end = text + file.size();
+  std::unordered_map<std::string, std::string> attributes;
+
+  auto attribute = [&](const char *name) -> const std::string & {
+    static const std::string none;
+    auto it = attributes.find(name);
+    return it != attributes.end() ? it->second : none;
+  };
+  auto number = [&](const char *name) {
+    return static_cast<uint32_t>(std::strtoul(attribute(name).c_str(),
+                                              nullptr, 10));
+  };
+
+  // Tile whose children are being read, -1 outside of tiles.
+  int64_t tile_id = -1;
+
+  for (const char *cursor = text; cursor < end;) {
+    const char *open = static_cast<const char *>(
+        std::memchr(cursor, '<', end - cursor));
+    if (!open) {
+      break;
+    }
+    const char *close =
+        static_cast<const char *>(std::memchr(open, '>', end - open));
+    if (!close) {
+      std::cerr << "Malformed tileset " << path << std::endl;
+      return false;
+    }
+    cursor = close + 1;
+
+    // Skip the declaration and comments.
+    if (open[1] == '?' || open[1] == '!') {
+      continue;
+    }
+    if (open[1] == '/') {
+      if (std::string(open + 2, close) == "tile") {
+        tile_id = -1;
+      }
+      continue;
+    }
+
+    // Split the tag into its name and attributes.
+    const char *position = open + 1;
+    while (position < close && !std::isspace(*position) && *position != '/')
+      position++;
+    std::string name(open + 1, position);
+    bool self_closing = close[-1] == '/';
+
+    attributes.clear();
+    while (position < close) {
+      const char *equals = static_cast<const char *>(
+          std::memchr(position, '=', close - position));
+      if (!equals || equals + 1 >= close || equals[1] != '"') {
+        break;
+      }
+      const char *key = position;
+      while (key < equals && std::isspace(*key))
+        key++;
+      const char *value = equals + 2;
+      const char *quote = static_cast<const char *>(
+          std::memchr(value, '"', close - value));
+      if (!quote) {
+        break;
+      }
+      attributes.emplace(std::string(key, equals), std::string(value, quote));
+      position = quote + 1;
+    }
+
+    if (name == "tileset") {
+      tileset.tile_count = number("tilecount");
+    } else if (name == "image" && tile_id < 0) {
+      tileset.image = attribute("source");
+      tileset.image_width = number("width");
+    } else if (name == "tile") {
+      tile_id = self_closing ? -1 : number("id");
+    } else if (name == "property" && tile_id >= 0) {
+      tileset.has_properties = true;
+      if (attribute("value") == "true") {
+        tileset.add_flags(tile_id, tile_flag(attribute("name")));
+      }
+    } else if (name == "frame" && tile_id >= 0) {
+      tileset.frames.push_back({static_cast<uint32_t>(tile_id),
+                                number("tileid"), number("duration")});
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Streaming (SAX) handler for Tiled maps. It tracks its position in the
+// document and only keeps the handful of values the game needs, decoding the
+// tile layers straight into the gid array without building a JSON tree.
+// ----------------------------------------------------------------------------------------------------
+class TmjHandler {
+public:
+  explicit TmjHandler(LevelData &level) : m_Level(level) {}
+
+  // Chunk of a tile layer of an infinite map, in Tiled's layout.
+  struct TiledChunk {
+    int32_t x = 0;
+    int32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint32_t> gids;
+    std::string encoded_data;
+  };
+
+  // Layer of the map. The tiles of finite maps are appended to the level's
+  // gids as they are parsed, starting at first.
+  struct TiledLayer {
+    std::string type;
+    LayerRole role = LayerRole::COLLIDABLE;
+    // Set on object layers whose shapes the player collides with.
+    bool collision = false;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t first = 0;
+    size_t count = 0;
+
+    // Tile data of an encoded layer.
+    std::string encoded_data;
+    std::string encoding;
+    std::string compression;
+
+    std::vector<TiledChunk> chunks;
+    std::vector<Rectangle> objects;
+  };
+
+  // The scalars the loader extracts from the map.
+  uint32_t tile_width = 0;
+  uint32_t tile_height = 0;
+  Vector2 spawn = default_spawn;
+  Vector2 flag = default_flag;
+
+  bool infinite = false;
+  std::vector<TiledLayer> layers;
+
+  // Bounding boxes of the collision objects in map pixels.
+  std::vector<Rectangle> shapes;
+
+  // The first tileset, unless it is stored in the external file source.
+  Tileset tileset;
+  std::string tileset_source;
+
+  bool null() { return next_value(); }
+  bool boolean(bool value) {
+    if (m_Stack.size() == 1 && m_Key == Key::INFINITE) {
+      infinite = value;
+    } else if (in_tile_property() && m_Key == Key::VALUE) {
+      m_PropertyBool = value;
+    }
+    return next_value();
+  }
+  bool number_integer(json::number_integer_t value) {
+    return number(static_cast<double>(value));
+  }
+  bool number_unsigned(json::number_unsigned_t value) {
+    // Tile ids are the bulk of the document, handle them first.
+    if (in_tile_data()) {
+      m_Level.gids.push_back(static_cast<uint32_t>(value));
+      m_Stack.back().index++;
+      return true;
+    }
+    if (in_chunk_data()) {
+      m_Chunk.gids.push_back(static_cast<uint32_t>(value));
+      m_Stack.back().index++;
+      return true;
+    }
+    return number(static_cast<double>(value));
+  }
+  bool number_float(json::number_float_t value, const json::string_t &) {
+    return number(value);
+  }
+  bool string(json::string_t &value) {
+    if (in_layer()) {
+      if (m_Key == Key::DATA)
+        // Take over the lexer's buffer instead of copying the tile data.
+        m_Layer.encoded_data.swap(value);
+      else if (m_Key == Key::ENCODING)
+        m_Layer.encoding = value;
+      else if (m_Key == Key::COMPRESSION)
+        m_Layer.compression = value;
+      else if (m_Key == Key::TYPE)
+        m_Layer.type = value;
+    } else if (in_chunk() && m_Key == Key::DATA) {
+      m_Chunk.encoded_data.swap(value);
+    } else if (in_first(Key::TILESETS) && m_Key == Key::SOURCE) {
+      tileset_source = value;
+    } else if (in_first(Key::TILESETS) && m_Key == Key::IMAGE) {
+      tileset.image = value;
+    } else if (in_property() || in_layer_property() || in_tile_property()) {
+      if (m_Key == Key::NAME)
+        m_PropertyName = value;
+      else if (m_Key == Key::VALUE)
+        m_PropertyString = value;
+    }
+    return next_value();
+  }
+  bool binary(json::binary_t &) { return next_value(); }
+
+  bool start_object(size_t) {
+    m_Stack.push_back({m_Key, false, 0});
+    m_Key = Key::OTHER;
+    if (in_layer()) {
+      m_Layer = {};
+      m_Layer.first = m_Level.gids.size();
+    }
+    if (in_object()) {
+      m_Object = {};
+    }
+    if (in_property() || in_layer_property() || in_tile_property()) {
+      m_PropertyName.clear();
+      m_PropertyString.clear();
+      m_PropertyValue = 0;
+      m_PropertyBool = false;
+    }
+    return true;
+  }
+  bool key(json::string_t &name) {
+    m_Key = to_key(name);
+    return true;
+  }
+  bool end_object() {
+    if (in_property() && m_PropertyName.size()) {
+      set_property();
+    }
+    if (in_layer_property() && m_PropertyName == "role") {
+      set_role();
+    }
+    if (in_chunk()) {
+      m_Layer.chunks.push_back(std::move(m_Chunk));
+      m_Chunk = {};
+    }
+    if (in_animation_frame()) {
+      m_TileFrames.push_back(m_Frame);
+      m_Frame = {};
+    }
+    if (in_polygon_point()) {
+      m_Object.add_point(m_Point);
+      m_Point = {};
+    }
+    if (in_object()) {
+      Rectangle bounds = m_Object.bounds();
+      if (bounds.width > 0 && bounds.height > 0) {
+        m_Layer.objects.push_back(bounds);
+      }
+    }
+    if (in_tile_property()) {
+      tileset.has_properties = true;
+      if (m_PropertyBool) {
+        m_TileFlags |= tile_flag(m_PropertyName);
+      }
+    }
+    if (in_tileset_tile()) {
+      for (auto &frame : m_TileFrames) {
+        frame.tile_id = m_TileId;
+        tileset.frames.push_back(frame);
+      }
+      m_TileFrames.clear();
+      tileset.add_flags(m_TileId, m_TileFlags);
+      m_TileFlags = 0;
+    }
+    if (in_layer() && !end_layer()) {
+      return false;
+    }
+    m_Stack.pop_back();
+    return next_value();
+  }
+  bool start_array(size_t) {
+    m_Stack.push_back({m_Key, true, 0});
+    return true;
+  }
+  bool end_array() {
+    m_Stack.pop_back();
+    return next_value();
+  }
+  bool parse_error(size_t position, const std::string &,
+                   const nlohmann::detail::exception &error) {
+    std::cerr << "Malformed level at byte " << position << ": "
+              << error.what() << std::endl;
+    return false;
+  }
+
+private:
+  // Keys of the Tiled map format the loader cares about.
+  enum class Key {
+    OTHER,
+    TILEWIDTH,
+    TILEHEIGHT,
+    WIDTH,
+    HEIGHT,
+    LAYERS,
+    DATA,
+    ENCODING,
+    COMPRESSION,
+    INFINITE,
+    CHUNKS,
+    X,
+    Y,
+    TYPE,
+    OBJECTS,
+    POLYGON,
+    TILESETS,
+    SOURCE,
+    IMAGE,
+    IMAGEWIDTH,
+    TILECOUNT,
+    TILES,
+    ID,
+    ANIMATION,
+    TILEID,
+    DURATION,
+    PROPERTIES,
+    NAME,
+    VALUE
+  };
+
+  // An open object or array and the key it is stored under.
+  struct Frame {
+    Key key;
+    bool array;
+    size_t index;
+  };
+
+  static Key to_key(const json::string_t &name) {
+    if (name == "data")
+      return Key::DATA;
+    if (name == "width")
+      return Key::WIDTH;
+    if (name == "height")
+      return Key::HEIGHT;
+    if (name == "tilewidth")
+      return Key::TILEWIDTH;
+    if (name == "tileheight")
+      return Key::TILEHEIGHT;
+    if (name == "layers")
+      return Key::LAYERS;
+    if (name == "encoding")
+      return Key::ENCODING;
+    if (name == "compression")
+      return Key::COMPRESSION;
+    if (name == "infinite")
+      return Key::INFINITE;
+    if (name == "chunks")
+      return Key::CHUNKS;
+    if (name == "x")
+      return Key::X;
+    if (name == "y")
+      return Key::Y;
+    if (name == "type")
+      return Key::TYPE;
+    if (name == "objects")
+      return Key::OBJECTS;
+    if (name == "polygon")
+      return Key::POLYGON;
+    if (name == "tilesets")
+      return Key::TILESETS;
+    if (name == "source")
+      return Key::SOURCE;
+    if (name == "image")
+      return Key::IMAGE;
+    if (name == "imagewidth")
+      return Key::IMAGEWIDTH;
+    if (name == "tilecount")
+      return Key::TILECOUNT;
+    if (name == "tiles")
+      return Key::TILES;
+    if (name == "id")
+      return Key::ID;
+    if (name == "animation")
+      return Key::ANIMATION;
+    if (name == "tileid")
+      return Key::TILEID;
+    if (name == "duration")
+      return Key::DURATION;
+    if (name == "properties")
+      return Key::PROPERTIES;
+    if (name == "name")
+      return Key::NAME;
+    if (name == "value")
+      return Key::VALUE;
+    return Key::OTHER;
+  }
+
+  // Inside the first element of the given top-level array.
+  bool in_first(Key key) const {
+    return m_Stack.size() == 3 && !m_Stack[2].array &&
+           m_Stack[1].key == key && m_Stack[1].index == 0;
+  }
+
+  // Inside a layer object.
+  bool in_layer() const {
+    return m_Stack.size() == 3 && !m_Stack[2].array &&
+           m_Stack[1].key == Key::LAYERS;
+  }
+
+  bool in_tile_data() const {
+    return m_Stack.size() == 4 && m_Stack[3].key == Key::DATA &&
+           m_Stack[1].key == Key::LAYERS;
+  }
+
+  // Inside a chunk object of a layer of an infinite map.
+  bool in_chunk() const {
+    return m_Stack.size() == 5 && !m_Stack[4].array &&
+           m_Stack[3].key == Key::CHUNKS && m_Stack[1].key == Key::LAYERS;
+  }
+
+  bool in_chunk_data() const {
+    return m_Stack.size() == 6 && m_Stack[5].key == Key::DATA &&
+           m_Stack[3].key == Key::CHUNKS && m_Stack[1].key == Key::LAYERS;
+  }
+
+  // Inside an object of an object layer.
+  bool in_object() const {
+    return m_Stack.size() == 5 && !m_Stack[4].array &&
+           m_Stack[3].key == Key::OBJECTS && m_Stack[1].key == Key::LAYERS;
+  }
+
+  // Inside a point of a polygon object.
+  bool in_polygon_point() const {
+    return m_Stack.size() == 7 && !m_Stack[6].array &&
+           m_Stack[5].key == Key::POLYGON && m_Stack[3].key == Key::OBJECTS &&
+           m_Stack[1].key == Key::LAYERS;
+  }
+
+  // Inside a property of the map.
+  bool in_property() const {
+    return m_Stack.size() == 3 && !m_Stack[2].array &&
+           m_Stack[1].key == Key::PROPERTIES;
+  }
+
+  // Inside a property of a layer.
+  bool in_layer_property() const {
+    return m_Stack.size() == 5 && !m_Stack[4].array &&
+           m_Stack[3].key == Key::PROPERTIES && m_Stack[1].key == Key::LAYERS;
+  }
+
+  // Inside a tile of the first tileset.
+  bool in_tileset_tile() const {
+    return m_Stack.size() == 5 && !m_Stack[4].array &&
+           m_Stack[3].key == Key::TILES && m_Stack[1].key == Key::TILESETS &&
+           m_Stack[1].index == 0;
+  }
+
+  // Inside a property of a tile of the first tileset.
+  bool in_tile_property() const {
+    return m_Stack.size() == 7 && !m_Stack[6].array &&
+           m_Stack[5].key == Key::PROPERTIES && m_Stack[3].key == Key::TILES &&
+           m_Stack[1].key == Key::TILESETS && m_Stack[1].index == 0;
+  }
+
+  // Inside an animation frame of a tile of the first tileset.
+  bool in_animation_frame() const {
+    return m_Stack.size() == 7 && !m_Stack[6].array &&
+           m_Stack[5].key == Key::ANIMATION && m_Stack[3].key == Key::TILES &&
+           m_Stack[1].key == Key::TILESETS && m_Stack[1].index == 0;
+  }
+
+  bool number(double value) {
+    if (m_Stack.size() == 1) {
+      if (m_Key == Key::TILEWIDTH)
+        tile_width = static_cast<uint32_t>(value);
+      else if (m_Key == Key::TILEHEIGHT)
+        tile_height = static_cast<uint32_t>(value);
+    } else if (in_layer()) {
+      if (m_Key == Key::WIDTH)
+        m_Layer.width = static_cast<uint32_t>(value);
+      else if (m_Key == Key::HEIGHT)
+        m_Layer.height = static_cast<uint32_t>(value);
+    } else if (in_first(Key::TILESETS)) {
+      if (m_Key == Key::IMAGEWIDTH)
+        tileset.image_width = static_cast<uint32_t>(value);
+      else if (m_Key == Key::TILECOUNT)
+        tileset.tile_count = static_cast<uint32_t>(value);
+    } else if (in_chunk()) {
+      if (m_Key == Key::X)
+        m_Chunk.x = static_cast<int32_t>(value);
+      else if (m_Key == Key::Y)
+        m_Chunk.y = static_cast<int32_t>(value);
+      else if (m_Key == Key::WIDTH)
+        m_Chunk.width = static_cast<uint32_t>(value);
+      else if (m_Key == Key::HEIGHT)
+        m_Chunk.height = static_cast<uint32_t>(value);
+    } else if (in_object()) {
+      if (m_Key == Key::X)
+        m_Object.x = static_cast<float>(value);
+      else if (m_Key == Key::Y)
+        m_Object.y = static_cast<float>(value);
+      else if (m_Key == Key::WIDTH)
+        m_Object.width = static_cast<float>(value);
+      else if (m_Key == Key::HEIGHT)
+        m_Object.height = static_cast<float>(value);
+    } else if (in_polygon_point()) {
+      if (m_Key == Key::X)
+        m_Point.x = static_cast<float>(value);
+      else if (m_Key == Key::Y)
+        m_Point.y = static_cast<float>(value);
+    } else if (in_tileset_tile() && m_Key == Key::ID) {
+      m_TileId = static_cast<uint32_t>(value);
+    } else if (in_animation_frame()) {
+      if (m_Key == Key::TILEID)
+        m_Frame.frame_id = static_cast<uint32_t>(value);
+      else if (m_Key == Key::DURATION)
+        m_Frame.duration_ms = static_cast<uint32_t>(value);
+    } else if (in_property() && m_Key == Key::VALUE) {
+      m_PropertyValue = static_cast<float>(value);
+    }
+    return next_value();
+  }
+
+  // Apply a map property such as the spawn or flag position.
+  void set_property() {
+    if (m_PropertyName == "spawn_x")
+      spawn.x = m_PropertyValue;
+    else if (m_PropertyName == "spawn_y")
+      spawn.y = m_PropertyValue;
+    else if (m_PropertyName == "flag_x")
+      flag.x = m_PropertyValue;
+    else if (m_PropertyName == "flag_y")
+      flag.y = m_PropertyValue;
+  }
+
+  // Apply the role property of a layer.
+  void set_role() {
+    if (m_PropertyString == "background")
+      m_Layer.role = LayerRole::BACKGROUND;
+    else if (m_PropertyString == "collidable")
+      m_Layer.role = LayerRole::COLLIDABLE;
+    else if (m_PropertyString == "animated")
+      m_Layer.role = LayerRole::ANIMATED;
+    else if (m_PropertyString == "foreground")
+      m_Layer.role = LayerRole::FOREGROUND;
+    else if (m_PropertyString == "collision")
+      m_Layer.collision = true;
+    else
+      std::cerr << "Unknown layer role " << m_PropertyString << std::endl;
+  }
+
+  // Finish a layer, decoding its tiles if they are encoded. Only the
+  // collision shapes of object layers are kept.
+  bool end_layer() {
+    if (m_Layer.type != "tilelayer") {
+      if (m_Layer.type == "objectgroup" && m_Layer.collision) {
+        shapes.insert(shapes.end(), m_Layer.objects.begin(),
+                      m_Layer.objects.end());
+      }
+      m_Level.gids.resize(m_Layer.first);
+      return true;
+    }
+
+    if (!m_Layer.encoded_data.empty()) {
+      if (m_Layer.encoding != "base64") {
+        std::cerr << "Unknown tile layer encoding " << m_Layer.encoding
+                  << std::endl;
+        return false;
+      }
+      // Decode into the tail of the gids, keeping the capacity of a reused
+      // level.
+      size_t tile_count = static_cast<size_t>(m_Layer.width) * m_Layer.height;
+      m_Level.gids.resize(m_Layer.first + tile_count);
+      if (!decode_layer(m_Layer.encoded_data, m_Layer.compression, tile_count,
+                        m_Level.gids.data() + m_Layer.first)) {
+        return false;
+      }
+      m_Layer.encoded_data.clear();
+    }
+
+    m_Layer.count = m_Level.gids.size() - m_Layer.first;
+    layers.push_back(std::move(m_Layer));
+    m_Layer = {};
+    return true;
+  }
+
+  // Advance the element index of the enclosing array.
+  bool next_value() {
+    if (!m_Stack.empty() && m_Stack.back().array) {
+      m_Stack.back().index++;
+    }
+    return true;
+  }
+
+  LevelData &m_Level;
+  std::vector<Frame> m_Stack;
+  Key m_Key = Key::OTHER;
+
+  std::string m_PropertyName;
+  std::string m_PropertyString;
+  float m_PropertyValue = 0;
+  bool m_PropertyBool = false;
+
+  TiledLayer m_Layer;
+  TiledChunk m_Chunk;
+
+  // Object being parsed. Polygon points are relative to its position.
+  struct TiledObject {
+    float x = 0;
+    float y = 0;
+    float width = 0;
+    float height = 0;
+    bool polygon = false;
+    Vector2 min = {0, 0};
+    Vector2 max = {0, 0};
+
+    void add_point(Vector2 point) {
+      if (!polygon) {
+        min = max = point;
+        polygon = true;
+      }
+      min = {std::min(min.x, point.x), std::min(min.y, point.y)};
+      max = {std::max(max.x, point.x), std::max(max.y, point.y)};
+    }
+
+    Rectangle bounds() const {
+      if (polygon) {
+        return {x + min.x, y + min.y, max.x - min.x, max.y - min.y};
+      }
+      return {x, y, width, height};
+    }
+  };
+  TiledObject m_Object;
+  Vector2 m_Point = {0, 0};
+
+  // Flags and animation of the tileset tile being parsed.
+  uint32_t m_TileId = 0;
+  uint8_t m_TileFlags = 0;
+  AnimationFrame m_Frame{};
+  std::vector<AnimationFrame> m_TileFrames;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Split the chunks of an infinite map into fixed-size chunks. Tiled's chunk
+// size is an editor setting, so tiles are re-bucketed into CHUNK_SIZE chunks
+// and empty chunks are dropped. All layers share the same chunks.
+static bool split_chunks(TmjHandler &handler, LevelData &level) {
+  const int32_t size = CHUNK_SIZE;
+  const size_t chunk_tiles = CHUNK_SIZE * CHUNK_SIZE;
+
+  // Round towards negative infinity, chunks may lie left of or above 0.
+  auto floor_div = [](int32_t value, int32_t divisor) {
+    return value / divisor - (value % divisor < 0 ? 1 : 0);
+  };
+
+  // Tiles are placed once all chunks are known, since a chunk may only
+  // have tiles in a later layer.
+  struct Placement {
+    uint32_t layer;
+    uint32_t chunk;
+    uint32_t local;
+    uint32_t gid;
+  };
+  std::vector<Placement> placements;
+  std::unordered_map<uint64_t, uint32_t> chunk_index;
+
+  for (uint32_t layer = 0; layer < handler.layers.size(); ++layer) {
+    auto &tiled_layer = handler.layers[layer];
+
+    for (auto &chunk : tiled_layer.chunks) {
+      size_t tile_count = static_cast<size_t>(chunk.width) * chunk.height;
+      if (tiled_layer.encoding == "base64") {
+        chunk.gids.resize(tile_count);
+        if (!decode_layer(chunk.encoded_data, tiled_layer.compression,
+                          tile_count, chunk.gids.data())) {
+          return false;
+        }
+      }
+      if (chunk.gids.size() != tile_count) {
+        std::cerr << "Chunk size mismatch" << std::endl;
+        return false;
+      }
+
+      for (size_t i = 0; i < tile_count; ++i) {
+        uint32_t gid = chunk.gids[i];
+        if (gid == 0) {
+          continue;
+        }
+
+        int32_t x = chunk.x + static_cast<int32_t>(i % chunk.width);
+        int32_t y = chunk.y + static_cast<int32_t>(i / chunk.width);
+        int32_t chunk_x = floor_div(x, size);
+        int32_t chunk_y = floor_div(y, size);
+
+        uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(chunk_x))
+                        << 32) |
+                       static_cast<uint32_t>(chunk_y);
+        auto [it, inserted] = chunk_index.try_emplace(
+            key, static_cast<uint32_t>(level.chunks.size()));
+        if (inserted) {
+          level.chunks.push_back({chunk_x * size, chunk_y * size});
+        }
+
+        uint32_t local = (y - chunk_y * size) * size + (x - chunk_x * size);
+        placements.push_back({layer, it->second, local, gid});
+      }
+    }
+  }
+
+  if (level.chunks.empty()) {
+    std::cerr << "Infinite map without tiles" << std::endl;
+    return false;
+  }
+
+  size_t cells = level.chunks.size() * chunk_tiles;
+  level.gids.assign(cells * handler.layers.size(), 0);
+  for (const auto &tile : placements) {
+    level.gids[tile.layer * cells + tile.chunk * chunk_tiles + tile.local] =
+        tile.gid;
+  }
+
+  level.header.chunk_size = CHUNK_SIZE;
+  level.header.chunk_count = static_cast<uint32_t>(level.chunks.size());
+  return true;
+}
+
+// Check that the tiles of a map fit into packed tiles: their tileset
+// indices stay within MAX_TILE_ID and their cells within the grid position
+// limits.
+static bool check_tile_limits(const LevelData &level, bool infinite,
+                              uint32_t width, uint32_t height) {
+  const int64_t last_cell = CHUNK_SIZE - 1;
+  if (infinite) {
+    for (const ChunkRecord &chunk : level.chunks) {
+      if (chunk.x < MIN_GRID_POSITION || chunk.y < MIN_GRID_POSITION ||
+          chunk.x + last_cell > MAX_GRID_POSITION ||
+          chunk.y + last_cell > MAX_GRID_POSITION) {
+        std::cerr << "Tiles around " << chunk.x << ", " << chunk.y
+                  << " are outside the grid positions from "
+                  << MIN_GRID_POSITION << " to " << MAX_GRID_POSITION
+                  << std::endl;
+        return false;
+      }
+    }
+  } else if (width > MAX_GRID_POSITION + 1u ||
+             height > MAX_GRID_POSITION + 1u) {
+    std::cerr << "Map of " << width << "x" << height
+              << " tiles is larger than " << MAX_GRID_POSITION + 1
+              << " tiles per side" << std::endl;
+    return false;
+  }
+
+  for (uint32_t gid : level.gids) {
+    // Extract the global ID and adjust for Tiled's 1-based indexing.
+    uint32_t id = gid & 0x0fffffff;
+    if (id > MAX_TILE_ID + 1) {
+      std::cerr << "Tile " << id - 1 << " is beyond the "
+                << MAX_TILE_ID + 1 << " tiles of a tileset a map can use"
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool parse_tmj(const std::string &path, LevelData &level) {
+  MappedFile file(path);
+  if (!file.is_open()) {
+    std::cerr << "Could not open level " << path << std::endl;
+    return false;
+  }
+  std::string directory = ".";
+  size_t separator = path.find_last_of('/');
+  if (separator != std::string::npos) {
+    directory = path.substr(0, separator);
+  }
+  if (!parse_tmj(reinterpret_cast<const char *>(file.data()), file.size(),
+                 level, directory)) {
+    std::cerr << "Could not parse level " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool parse_tmj(const char *data, size_t size, LevelData &level,
+               const std::string &directory) {
+  // Keep the capacity of a reused level to avoid reallocating the tiles.
+  level.gids.clear();
+
+  TmjHandler handler(level);
+  if (!json::sax_parse(data, data + size, &handler)) {
+    return false;
+  }
+
+  Tileset &tileset = handler.tileset;
+  std::string tileset_directory = directory;
+  if (!handler.tileset_source.empty()) {
+    std::string source = directory + "/" + handler.tileset_source;
+    if (!parse_tsx(source, tileset)) {
+      return false;
+    }
+    tileset_directory = source.substr(0, source.find_last_of('/'));
+  }
+  level.tileset_image.clear();
+  if (!tileset.image.empty()) {
+    level.tileset_image = tileset_directory + "/" + tileset.image;
+  }
+
+  Header &header = level.header;
+  header = {};
+  level.chunks.clear();
+  level.layers.clear();
+
+  if (handler.layers.empty()) {
+    std::cerr << "Map without tile layers" << std::endl;
+    return false;
+  }
+  const auto &first_layer = handler.layers.front();
+
+  if (handler.infinite) {
+    if (!split_chunks(handler, level)) {
+      return false;
+    }
+  } else {
+    size_t cells = static_cast<size_t>(first_layer.width) * first_layer.height;
+    for (const auto &layer : handler.layers) {
+      if (cells == 0 || layer.width != first_layer.width ||
+          layer.height != first_layer.height || layer.count != cells) {
+        std::cerr << "Tile layer size mismatch" << std::endl;
+        return false;
+      }
+    }
+  }
+  if (handler.tile_width == 0 || handler.tile_height == 0) {
+    std::cerr << "Missing tile size" << std::endl;
+    return false;
+  }
+  // Tiles are located by their column in the tileset image.
+  if (tileset.image_width < handler.tile_width) {
+    std::cerr << "Missing tileset image width" << std::endl;
+    return false;
+  }
+  if (!check_tile_limits(level, handler.infinite, first_layer.width,
+                         first_layer.height)) {
+    return false;
+  }
+
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.width = first_layer.width;
+  header.height = first_layer.height;
+  header.tile_width = handler.tile_width;
+  header.tile_height = handler.tile_height;
+  header.tileset_columns = tileset.image_width / handler.tile_width;
+
+  header.spawn_x = handler.spawn.x;
+  header.spawn_y = handler.spawn.y;
+  header.flag_x = handler.flag.x;
+  header.flag_y = handler.flag.y;
+
+  for (const auto &layer : handler.layers) {
+    level.layers.push_back({layer.role});
+  }
+  header.layer_count = static_cast<uint32_t>(level.layers.size());
+
+  // Keep the frames of each tile in order.
+  level.frames = std::move(tileset.frames);
+  std::stable_sort(level.frames.begin(), level.frames.end(),
+                   [](const AnimationFrame &a, const AnimationFrame &b) {
+                     return a.tile_id < b.tile_id;
+                   });
+  header.frame_count = static_cast<uint32_t>(level.frames.size());
+
+  // TileMap and screen have a 1:4 ratio.
+  level.shapes.clear();
+  for (const auto &shape : handler.shapes) {
+    level.shapes.push_back(
+        {shape.x * 4, shape.y * 4, shape.width * 4, shape.height * 4});
+  }
+  header.shape_count = static_cast<uint32_t>(level.shapes.size());
+
+  // Every tile of the map gets an entry in the flag table, so lookups by
+  // gid don't need a bounds check.
+  size_t type_count = std::max<size_t>(tileset.tile_count, tileset.flags.size());
+  for (uint32_t gid : level.gids) {
+    // Extract the global ID and adjust for Tiled's 1-based indexing.
+    type_count = std::max<size_t>(type_count, gid & 0x0fffffff);
+  }
+  level.tile_flags.assign(type_count, 0);
+  for (size_t tile_id = 0; tile_id < type_count; ++tile_id) {
+    if (!tileset.has_properties) {
+      level.tile_flags[tile_id] = default_tile_flags(tile_id);
+    } else if (tile_id < tileset.flags.size()) {
+      level.tile_flags[tile_id] = tileset.flags[tile_id];
+    }
+  }
+  header.tile_type_count = static_cast<uint32_t>(type_count);
+
+  // Merge the flags of the gameplay layers per cell. Background and
+  // foreground layers are decoration only.
+  size_t cells = cell_count(header);
+  level.cell_flags.assign(cells, 0);
+  for (uint32_t layer = 0; layer < header.layer_count; ++layer) {
+    LayerRole role = level.layers[layer].role;
+    if (role != LayerRole::COLLIDABLE && role != LayerRole::ANIMATED) {
+      continue;
+    }
+    const uint32_t *gids = level.gids.data() + layer * cells;
+    for (size_t cell = 0; cell < cells; ++cell) {
+      if (gids[cell] != 0) {
+        level.cell_flags[cell] |=
+            level.tile_flags[(gids[cell] & 0x0fffffff) - 1];
+      }
+    }
+  }
+
+  size_t tile_count = level.gids.size();
+  header.chunks_offset = sizeof(Header);
+  header.layers_offset = header.chunks_offset +
+                         header.chunk_count * sizeof(ChunkRecord);
+  header.frames_offset = header.layers_offset +
+                         header.layer_count * sizeof(LayerRecord);
+  header.shapes_offset = header.frames_offset +
+                         header.frame_count * sizeof(AnimationFrame);
+  header.tiles_offset = header.shapes_offset +
+                        header.shape_count * sizeof(Rectangle);
+  header.tile_flags_offset =
+      header.tiles_offset + static_cast<uint32_t>(tile_count * sizeof(uint32_t));
+  header.cell_flags_offset = header.tile_flags_offset + header.tile_type_count;
+  header.file_size =
+      header.cell_flags_offset + static_cast<uint32_t>(level.cell_flags.size());
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+void mark_fill_tiles(LevelData &level, const Color *pixels, int width,
+                     int height) {
+  const Header &header = level.header;
+  if (pixels == nullptr || header.tile_width == 0 ||
+      header.tile_height == 0) {
+    return;
+  }
+  int tile_width = static_cast<int>(header.tile_width);
+  int tile_height = static_cast<int>(header.tile_height);
+
+  for (size_t tile_id = 0; tile_id < level.tile_flags.size(); ++tile_id) {
+    int x = static_cast<int>(tile_id % header.tileset_columns) * tile_width;
+    int y = static_cast<int>(tile_id / header.tileset_columns) * tile_height;
+    if (x + tile_width > width || y + tile_height > height) {
+      continue;
+    }
+
+    Color first = pixels[y * width + x];
+    bool fill = first.a == 255;
+    for (int row = y; row < y + tile_height && fill; ++row) {
+      for (int col = x; col < x + tile_width && fill; ++col) {
+        const Color &pixel = pixels[row * width + col];
+        fill = pixel.r == first.r && pixel.g == first.g &&
+               pixel.b == first.b && pixel.a == first.a;
+      }
+    }
+    if (fill) {
+      level.tile_flags[tile_id] |= TILE_FILL;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool write_binary(const std::string &path, const LevelData &level) {
+  // Write to a temporary file first so a running game never maps a partially
+  // written level.
+  std::string temp_path = path + ".tmp";
+  std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char *>(&level.header), sizeof(Header));
+  file.write(reinterpret_cast<const char *>(level.chunks.data()),
+             level.chunks.size() * sizeof(ChunkRecord));
+  file.write(reinterpret_cast<const char *>(level.layers.data()),
+             level.layers.size() * sizeof(LayerRecord));
+  file.write(reinterpret_cast<const char *>(level.frames.data()),
+             level.frames.size() * sizeof(AnimationFrame));
+  file.write(reinterpret_cast<const char *>(level.shapes.data()),
+             level.shapes.size() * sizeof(Rectangle));
+  file.write(reinterpret_cast<const char *>(level.gids.data()),
+             level.gids.size() * sizeof(uint32_t));
+  file.write(reinterpret_cast<const char *>(level.tile_flags.data()),
+             level.tile_flags.size());
+  file.write(reinterpret_cast<const char *>(level.cell_flags.data()),
+             level.cell_flags.size());
+  file.close();
+
+  if (!file) {
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool read_binary(const unsigned char *data, size_t size, LevelView &view) {
+  if (size < sizeof(Header) ||
+      reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) {
+    return false;
+  }
+
+  Header header;
+  std::memcpy(&header, data, sizeof(Header));
+
+  bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+               header.version == VERSION && header.file_size == size &&
+               (header.chunk_size == 0 || header.chunk_size == CHUNK_SIZE);
+  // Every cell takes at least a byte of the file. Bounding the cell and
+  // tile counts by the size keeps the section sizes below from wrapping.
+  size_t cells = valid ? cell_count(header) : 0;
+  valid = valid && cells <= size &&
+          header.layer_count <= size / std::max<size_t>(cells, 1);
+  size_t tile_count = cells * header.layer_count;
+  valid = valid && header.layer_count > 0 && header.tile_width > 0 &&
+      header.tile_height > 0 && header.tileset_columns > 0 &&
+      (header.chunk_size > 0 || (header.width <= MAX_GRID_POSITION + 1u &&
+                                 header.height <= MAX_GRID_POSITION + 1u)) &&
+      header.chunks_offset % alignof(ChunkRecord) == 0 &&
+      header.chunks_offset + header.chunk_count * sizeof(ChunkRecord) <=
+          header.layers_offset &&
+      header.layers_offset % alignof(LayerRecord) == 0 &&
+      header.layers_offset + header.layer_count * sizeof(LayerRecord) <=
+          header.frames_offset &&
+      header.frames_offset % alignof(AnimationFrame) == 0 &&
+      header.frames_offset + header.frame_count * sizeof(AnimationFrame) <=
+          header.shapes_offset &&
+      header.shapes_offset % alignof(Rectangle) == 0 &&
+      header.shapes_offset + header.shape_count * sizeof(Rectangle) <=
+          header.tiles_offset &&
+      header.tiles_offset % alignof(uint32_t) == 0 &&
+      header.tiles_offset + tile_count * sizeof(uint32_t) <=
+          header.tile_flags_offset &&
+      header.tile_flags_offset + header.tile_type_count <=
+          header.cell_flags_offset &&
+      header.cell_flags_offset + cells <= header.file_size;
+
+  if (!valid) {
+    return false;
+  }
+
+  view.header = header;
+  view.gids =
+      reinterpret_cast<const uint32_t *>(data + header.tiles_offset);
+
+  // Every gid must have an entry in the flag table for flags_of and fit
+  // into a packed tile.
+  for (size_t tile = 0; tile < tile_count; ++tile) {
+    uint32_t id = view.gids[tile] & 0x0fffffff;
+    if (id > header.tile_type_count || id > MAX_TILE_ID + 1) {
+      return false;
+    }
+  }
+  view.tile_flags = data + header.tile_flags_offset;
+  view.cell_flags = data + header.cell_flags_offset;
+  view.chunks =
+      reinterpret_cast<const ChunkRecord *>(data + header.chunks_offset);
+  for (uint32_t chunk = 0; chunk < header.chunk_count; ++chunk) {
+    const ChunkRecord &record = view.chunks[chunk];
+    if (record.x < MIN_GRID_POSITION || record.y < MIN_GRID_POSITION ||
+        record.x + int64_t{header.chunk_size} - 1 > MAX_GRID_POSITION ||
+        record.y + int64_t{header.chunk_size} - 1 > MAX_GRID_POSITION) {
+      return false;
+    }
+  }
+  view.layers =
+      reinterpret_cast<const LayerRecord *>(data + header.layers_offset);
+  // Roles index the batches of a level.
+  for (uint32_t layer = 0; layer < header.layer_count; ++layer) {
+    if (static_cast<uint32_t>(view.layers[layer].role) >= LAYER_ROLE_COUNT) {
+      return false;
+    }
+  }
+  view.frames = reinterpret_cast<const AnimationFrame *>(data +
+                                                         header.frames_offset);
+  view.shapes =
+      reinterpret_cast<const Rectangle *>(data + header.shapes_offset);
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool map_binary(const std::string &path, MappedFile &file, LevelView &view) {
+  if (!file.open(path)) {
+    return false;
+  }
+  if (!read_binary(file.data(), file.size(), view)) {
+    std::cerr << "Invalid compiled level " << path << std::endl;
+    file.close();
+    return false;
+  }
+  return true;
+}
+} // namespace Inversion::LevelFormat
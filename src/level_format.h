@@ -0,0 +1,243 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "raylib.h"
+
+#include "./mapped_file.h"
+
+namespace Inversion::LevelFormat {
+// ----------------------------------------------------------------------------------------------------
+// Compiled binary level format.
+//
+// Layout: [Header][chunk records][layer records][animation frames]
+//         [collision shapes][tile gids: uint32][tile flags: uint8]
+//         [cell flags: uint8]
+// The tile array starts 4-byte aligned so it can be read in place from a
+// memory-mapped file. The format uses the host byte order (little endian).
+//
+// Finite maps store width * height cells per layer and no chunk records.
+// Infinite maps store chunk_count square chunks of chunk_size tiles each, one
+// after the other, so a chunk's tiles and cell flags are contiguous.
+// The cells of all layers follow each other in map order.
+//
+// The tile flags hold the TileFlag bits of every tileset tile. The cell
+// flags merge the tile flags over the gameplay (collidable and animated)
+// layers, one byte per cell. Maps with a collision object layer store its
+// shapes and collide with those instead of solid cells.
+// ----------------------------------------------------------------------------------------------------
+constexpr char MAGIC[4] = {'I', 'N', 'V', 'L'};
+constexpr uint32_t VERSION = 6;
+
+// Side length in tiles of the chunks infinite maps are stored in.
+constexpr uint32_t CHUNK_SIZE = 16;
+
+// Largest 0-based tileset index and range of the grid positions of the tiles
+// of a level. Levels are drawn from packed tiles, which have no room for
+// more, see PackedTile.
+constexpr uint32_t MAX_TILE_ID = 0x1fff;
+constexpr int32_t MIN_GRID_POSITION = -32768;
+constexpr int32_t MAX_GRID_POSITION = 32767;
+
+// How the tiles of a layer are used, set with the "role" property of a tile
+// layer in Tiled. Roles are listed in drawing order.
+enum class LayerRole : uint32_t {
+  // Static scenery behind the player.
+  BACKGROUND,
+  // Static tiles the player collides with. Layers without a role.
+  COLLIDABLE,
+  // Tiles that play the animations of the tileset.
+  ANIMATED,
+  // Decoration drawn in front of the player.
+  FOREGROUND,
+};
+constexpr size_t LAYER_ROLE_COUNT = 4;
+
+// Behaviour of a tile, set with boolean properties of the same name on the
+// tiles of the tileset.
+enum TileFlag : uint8_t {
+  // Blocks the player.
+  TILE_SOLID = 1 << 0,
+  // Sends the player back to the spawn.
+  TILE_HAZARD = 1 << 1,
+  // Blocks the player only when landing on it.
+  TILE_ONE_WAY = 1 << 2,
+  // Flips the gravity when the player enters it.
+  TILE_GRAVITY_FLIP = 1 << 3,
+  // Every pixel of the tile has the same opaque colour, so runs of it can be
+  // drawn as one stretched tile. Set by mark_fill_tiles, only in the tile
+  // flag table.
+  TILE_FILL = 1 << 4,
+};
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+
+  // Map size in tiles and tile size in tileset pixels.
+  uint32_t width;
+  uint32_t height;
+  uint32_t tile_width;
+  uint32_t tile_height;
+  uint32_t tileset_columns;
+
+  // Player spawn and goal flag in screen coordinates.
+  float spawn_x;
+  float spawn_y;
+  float flag_x;
+  float flag_y;
+
+  // Chunk side length in tiles, 0 for finite maps.
+  uint32_t chunk_size;
+  uint32_t chunk_count;
+
+  uint32_t layer_count;
+  uint32_t frame_count;
+  uint32_t shape_count;
+  // Number of entries of the tile flag table.
+  uint32_t tile_type_count;
+
+  // Byte offsets of the sections relative to the start of the file.
+  uint32_t chunks_offset;
+  uint32_t layers_offset;
+  uint32_t frames_offset;
+  uint32_t shapes_offset;
+  uint32_t tiles_offset;
+  uint32_t tile_flags_offset;
+  uint32_t cell_flags_offset;
+  uint32_t file_size;
+};
+
+// Position of a chunk's top-left tile in tile coordinates.
+struct ChunkRecord {
+  int32_t x;
+  int32_t y;
+};
+
+// Tile layer of a map.
+struct LayerRecord {
+  LayerRole role;
+};
+
+// One frame of a tile animation from the tileset. The frames of a tile are
+// stored in order, the records are sorted by tile.
+struct AnimationFrame {
+  // 0-based tileset indices of the animated tile and the shown tile.
+  uint32_t tile_id;
+  uint32_t frame_id;
+  uint32_t duration_ms;
+};
+
+// Number of cells of a single layer.
+inline size_t cell_count(const Header &header) {
+  if (header.chunk_size > 0) {
+    return static_cast<size_t>(header.chunk_count) * header.chunk_size *
+           header.chunk_size;
+  }
+  return static_cast<size_t>(header.width) * header.height;
+}
+
+// Number of tiles stored in a level, over all layers.
+inline size_t tile_count(const Header &header) {
+  return cell_count(header) * header.layer_count;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Non-owning view of a level, either decoded from JSON or mapped from disk.
+struct LevelView {
+  Header header;
+  const uint32_t *gids = nullptr;
+  // TileFlag bits per tileset tile and per cell.
+  const uint8_t *tile_flags = nullptr;
+  const uint8_t *cell_flags = nullptr;
+  const ChunkRecord *chunks = nullptr;
+  const LayerRecord *layers = nullptr;
+  const AnimationFrame *frames = nullptr;
+  // Collision shapes in screen coordinates.
+  const Rectangle *shapes = nullptr;
+
+  // Flags of a tile by its gid. Every tile of the map has an entry.
+  uint8_t flags_of(uint32_t gid) const {
+    return gid == 0 ? 0 : tile_flags[(gid & 0x0fffffff) - 1];
+  }
+
+  // Check if the cell at the given index of a layer is solid.
+  bool is_solid(size_t cell) const { return cell_flags[cell] & TILE_SOLID; }
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Decoded level that owns its tile and collision data.
+struct LevelData {
+  Header header{};
+  std::vector<uint32_t> gids;
+  std::vector<uint8_t> tile_flags;
+  std::vector<uint8_t> cell_flags;
+  std::vector<ChunkRecord> chunks;
+  std::vector<LayerRecord> layers;
+  std::vector<AnimationFrame> frames;
+  std::vector<Rectangle> shapes;
+
+  // Path of the tileset image, set by parse_tmj. Not stored in the binary.
+  std::string tileset_image;
+
+  LevelView view() const {
+    return {header,          gids.data(),   tile_flags.data(),
+            cell_flags.data(), chunks.data(), layers.data(),
+            frames.data(),     shapes.data()};
+  }
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Parse a Tiled map (.tmj) into level data. Used on the authoring path.
+// The map is streamed without building a JSON tree; passing in a reused
+// LevelData avoids reallocating the tile array. Tile layers may be stored
+// as CSV arrays or base64, uncompressed or compressed with zlib, gzip or
+// zstd (the latter only in builds with ZSTD=1). Infinite maps are split
+// into chunks of CHUNK_SIZE tiles, leaving out chunks without any tiles.
+// All tile layers are loaded. Rectangles, ellipses and polygons of object
+// layers with the "collision" role become collision shapes, using their
+// bounding boxes. Other layers are skipped. Tile properties and animations
+// are read from the first tileset, which may be embedded in the map or an
+// external .tsx file relative to the given directory. Tilesets without any
+// tile properties fall back to the built-in list of solid tiles. Maps using
+// tileset indices above MAX_TILE_ID or cells outside the grid positions
+// limits are rejected.
+bool parse_tmj(const std::string &path, LevelData &level);
+bool parse_tmj(const char *data, size_t size, LevelData &level,
+               const std::string &directory = ".");
+
+// ----------------------------------------------------------------------------------------------------
+// Flag the tiles of the tileset whose pixels all have the same opaque colour
+// with TILE_FILL. Takes the RGBA pixels of the tileset image.
+void mark_fill_tiles(LevelData &level, const Color *pixels, int width,
+                     int height);
+
+// ----------------------------------------------------------------------------------------------------
+// Write level data in the compiled binary format.
+bool write_binary(const std::string &path, const LevelData &level);
+
+// ----------------------------------------------------------------------------------------------------
+// Validate a compiled level in memory. The view points into the data, which
+// has to be 4-byte aligned.
+bool read_binary(const unsigned char *data, size_t size, LevelView &view);
+
+// ----------------------------------------------------------------------------------------------------
+// Map a compiled level and validate it. The view points into the mapping and
+// is only valid as long as the file stays mapped.
+bool map_binary(const std::string &path, MappedFile &file, LevelView &view);
+
+// ----------------------------------------------------------------------------------------------------
+// Flags of a tile (0-based tileset index) for tilesets without properties.
+uint8_t default_tile_flags(unsigned tile_id);
+} // namespace Inversion::LevelFormat
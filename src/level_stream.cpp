@@ -0,0 +1,225 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "./level_stream.h"
+#include "./tile_builder.h"
+
+namespace Inversion {
+
+using LevelFormat::LevelData;
+using LevelFormat::LevelView;
+
+// Key of a chunk in the index, both coordinates packed into 64 bits.
+static uint64_t chunk_key(int32_t chunk_x, int32_t chunk_y) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(chunk_x)) << 32) |
+         static_cast<uint32_t>(chunk_y);
+}
+
+// ----------------------------------------------------------------------------------------------------
+ChunkStore::ChunkStore(MappedFile file, const LevelView &view)
+    : m_File(std::move(file)), m_View(view) {
+  // Moving the file keeps the mapping, so the view stays valid.
+  build_index();
+}
+
+ChunkStore::ChunkStore(LevelData data) : m_Data(std::move(data)) {
+  m_View = m_Data.view();
+  build_index();
+}
+
+void ChunkStore::build_index() {
+  const auto &header = m_View.header;
+  m_Index.reserve(header.chunk_count);
+  for (uint32_t i = 0; i < header.chunk_count; ++i) {
+    const auto &record = m_View.chunks[i];
+    int32_t size = static_cast<int32_t>(header.chunk_size);
+    m_Index.emplace(chunk_key(record.x / size, record.y / size), i);
+  }
+}
+
+int ChunkStore::find(int32_t chunk_x, int32_t chunk_y) const {
+  auto it = m_Index.find(chunk_key(chunk_x, chunk_y));
+  return it != m_Index.end() ? static_cast<int>(it->second) : -1;
+}
+
+bool ChunkStore::same_tiles(int chunk, const ChunkStore &other,
+                            int other_chunk) const {
+  const auto &header = m_View.header;
+  const auto &other_header = other.m_View.header;
+  if (other_header.chunk_size != header.chunk_size ||
+      other_header.layer_count != header.layer_count) {
+    return false;
+  }
+
+  size_t chunk_tiles = header.chunk_size * header.chunk_size;
+  size_t cells = LevelFormat::cell_count(header);
+  size_t other_cells = LevelFormat::cell_count(other_header);
+
+  for (uint32_t layer = 0; layer < header.layer_count; ++layer) {
+    if (m_View.layers[layer].role != other.m_View.layers[layer].role ||
+        std::memcmp(
+            m_View.gids + layer * cells + chunk * chunk_tiles,
+            other.m_View.gids + layer * other_cells + other_chunk * chunk_tiles,
+            chunk_tiles * sizeof(uint32_t)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelStream::reset(LevelHandle level, Vector2 position) {
+  m_Level = std::move(level);
+  m_Resident.clear();
+  if (!is_active()) {
+    return;
+  }
+
+  m_Center = chunk_at(position);
+  stream_around(m_Center);
+}
+
+// ----------------------------------------------------------------------------------------------------
+void LevelStream::replace(LevelHandle level) {
+  const ChunkStore &previous = *m_Level->chunks;
+  const ChunkStore &store = *level->chunks;
+
+  for (auto it = m_Resident.begin(); it != m_Resident.end();) {
+    auto [chunk_x, chunk_y] = it->first;
+    int old_chunk = previous.find(chunk_x, chunk_y);
+    int new_chunk = store.find(chunk_x, chunk_y);
+
+    if (new_chunk < 0) {
+      it = m_Resident.erase(it);
+      continue;
+    }
+    if (old_chunk < 0 || !previous.same_tiles(old_chunk, store, new_chunk)) {
+      it->second = build_chunk(store.view(), new_chunk);
+    }
+    ++it;
+  }
+
+  // Keep the old store alive until the comparison is done.
+  m_Level = std::move(level);
+
+  // Chunks that used to be empty may have tiles now.
+  stream_around(m_Center);
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool LevelStream::update(Vector2 position) {
+  if (!is_active()) {
+    return false;
+  }
+
+  ChunkCoord center = chunk_at(position);
+  if (center == m_Center) {
+    return false;
+  }
+  m_Center = center;
+  return stream_around(center);
+}
+
+// ----------------------------------------------------------------------------------------------------
+LevelHandle LevelStream::assemble() const {
+  auto level = std::make_shared<TileMapping>();
+  level->flag_coords = m_Level->flag_coords;
+  level->flag_flipped = m_Level->flag_flipped;
+  level->spawn = m_Level->spawn;
+  level->columns = m_Level->columns;
+  level->rows = m_Level->rows;
+  level->geometry = m_Level->geometry;
+  level->bounds = m_Level->bounds;
+  level->chunks = m_Level->chunks;
+  level->layer_roles = m_Level->layer_roles;
+  level->animations = m_Level->animations;
+
+  auto append = [](auto &to, const auto &from) {
+    to.insert(to.end(), from.begin(), from.end());
+  };
+
+  for (size_t role = 0; role < level->batches.size(); ++role) {
+    TileBatch &batch = level->batches[role];
+
+    size_t tile_count = 0;
+    for (const auto &[coord, chunk] : m_Resident) {
+      tile_count += chunk.batches[role].tiles.size();
+    }
+    batch.tiles.reserve(tile_count);
+
+    for (const auto &[coord, chunk] : m_Resident) {
+      append(batch.tiles, chunk.batches[role].tiles);
+    }
+  }
+
+  // Collision objects cover the whole level, flagged cells come with their
+  // chunks.
+  std::vector<Rectangle> shapes = m_Level->collision->shapes();
+  std::vector<uint8_t> flags = m_Level->collision->flags();
+  for (const auto &[coord, chunk] : m_Resident) {
+    append(shapes, chunk.collision->shapes());
+    append(flags, chunk.collision->flags());
+  }
+  level->collision =
+      std::make_shared<CollisionStore>(std::move(shapes), std::move(flags));
+  return level;
+}
+
+// ----------------------------------------------------------------------------------------------------
+LevelStream::ChunkCoord LevelStream::chunk_at(Vector2 position) const {
+  const auto &header = m_Level->chunks->view().header;
+
+  // TileMap and screen have a 1:4 ratio.
+  float chunk_width = 4.f * header.tile_width * header.chunk_size;
+  float chunk_height = 4.f * header.tile_height * header.chunk_size;
+  return {static_cast<int32_t>(std::floor(position.x / chunk_width)),
+          static_cast<int32_t>(std::floor(position.y / chunk_height))};
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool LevelStream::stream_around(ChunkCoord center) {
+  bool changed = false;
+
+  // Evict with some slack so walking along a chunk border doesn't rebuild
+  // the same chunks over and over.
+  for (auto it = m_Resident.begin(); it != m_Resident.end();) {
+    int32_t distance = std::max(std::abs(it->first.first - center.first),
+                                std::abs(it->first.second - center.second));
+    if (distance > evict_radius) {
+      it = m_Resident.erase(it);
+      changed = true;
+    } else {
+      ++it;
+    }
+  }
+
+  const ChunkStore &store = *m_Level->chunks;
+  for (int32_t y = center.second - load_radius;
+       y <= center.second + load_radius; ++y) {
+    for (int32_t x = center.first - load_radius;
+         x <= center.first + load_radius; ++x) {
+      if (m_Resident.count({x, y})) {
+        continue;
+      }
+      int chunk = store.find(x, y);
+      if (chunk >= 0) {
+        m_Resident.emplace(ChunkCoord{x, y}, build_chunk(store.view(), chunk));
+        changed = true;
+      }
+    }
+  }
+  return changed;
+}
+} // namespace Inversion
@@ -0,0 +1,90 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+#include "raylib.h"
+
+#include "./level_format.h"
+#include "./mapped_file.h"
+#include "./tile_mapping.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Immutable chunk storage of an infinite level. It either owns the mapping
+// of a compiled level or the decoded data of a Tiled map.
+class ChunkStore {
+public:
+  ChunkStore(MappedFile file, const LevelFormat::LevelView &view);
+  explicit ChunkStore(LevelFormat::LevelData data);
+
+  const LevelFormat::LevelView &view() const { return m_View; }
+
+  // Index of the chunk at the given chunk coordinates, or -1 if the chunk is
+  // empty.
+  int find(int32_t chunk_x, int32_t chunk_y) const;
+
+  // Check if the tiles of a chunk are equal to a chunk of another store.
+  bool same_tiles(int chunk, const ChunkStore &other, int other_chunk) const;
+
+private:
+  void build_index();
+
+  MappedFile m_File;
+  LevelFormat::LevelData m_Data;
+  LevelFormat::LevelView m_View;
+  std::unordered_map<uint64_t, uint32_t> m_Index;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Keeps the chunks of an infinite level around a position resident. Chunks
+// are built when they come into range and evicted once they are further
+// away, so memory and per-frame work depend on the neighbourhood only.
+class LevelStream {
+public:
+  // Chunks within this distance (in chunks) of the player are resident.
+  static constexpr int32_t load_radius = 2;
+  // Chunks further away than this are evicted.
+  static constexpr int32_t evict_radius = load_radius + 1;
+
+  // Start streaming a level around a position, dropping all chunks.
+  void reset(LevelHandle level, Vector2 position);
+
+  // Switch to a new version of the same level. Only resident chunks whose
+  // tiles changed are rebuilt.
+  void replace(LevelHandle level);
+
+  // Load and evict chunks for the given position. Returns true if the set of
+  // resident chunks changed.
+  bool update(Vector2 position);
+
+  // Merge the resident chunks into a level for rendering and collisions.
+  LevelHandle assemble() const;
+
+  bool is_active() const { return m_Level && m_Level->chunks; }
+  size_t resident_chunks() const { return m_Resident.size(); }
+
+private:
+  using ChunkCoord = std::pair<int32_t, int32_t>;
+
+  ChunkCoord chunk_at(Vector2 position) const;
+  bool stream_around(ChunkCoord center);
+
+  LevelHandle m_Level;
+  ChunkCoord m_Center = {0, 0};
+
+  // Built chunks by chunk coordinates, ordered to keep assembly stable.
+  std::map<ChunkCoord, TileMapping> m_Resident;
+};
+} // namespace Inversion
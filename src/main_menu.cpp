@@ -35,13 +35,14 @@ MainMenu::MainMenu() {
 
 // ----------------------------------------------------------------------------------------------------
 void MainMenu::draw_menu() {
-  DrawTextEx(Inversion::AssetManager::get_font("menu"), "MENU", {200, 200}, 200,
-             30, WHITE);
+  DrawTextEx(Inversion::AssetManager::get_font(FontId::MENU), "MENU",
+             {200, 200}, 200, 30, WHITE);
 
   for (auto &menu : m_Menu) {
     DrawRectangleRec(menu.m_Rect, menu.m_Color);
-    DrawTextEx(Inversion::AssetManager::get_font("menu"), menu.m_Text.c_str(),
-               {menu.m_Rect.x + 10, menu.m_Rect.y + 20}, 70, 20, BLACK);
+    DrawTextEx(Inversion::AssetManager::get_font(FontId::MENU),
+               menu.m_Text.c_str(), {menu.m_Rect.x + 10, menu.m_Rect.y + 20},
+               70, 20, BLACK);
   }
 }
 
@@ -116,7 +117,7 @@ void MainMenu::update_balls() {
 // Class that handles the level selection menu.
 LevelSelection::LevelSelection(LevelManager *level) : m_Level(level) {
 
-  for (int i = 0; i < 16; ++i) {
+  for (int i = 0; i < m_Level->level_count(); ++i) {
     if (i == 0) {
       m_Offset.y = 120;
     } else if (i % 4 == 0) {
@@ -147,9 +148,9 @@ void LevelSelection::draw_menu() {
       x_offset = 45;
     }
 
-    DrawTextEx(AssetManager::get_font("level"), box.m_Text.c_str(),
+    DrawTextEx(AssetManager::get_font(FontId::LEVEL), box.m_Text.c_str(),
                {box.m_Rect.x + x_offset, box.m_Rect.y + 35},
-               AssetManager::get_font("level").baseSize, 0, BLACK);
+               AssetManager::get_font(FontId::LEVEL).baseSize, 0, BLACK);
   }
 }
 void LevelSelection::handle_input() {
@@ -167,8 +168,7 @@ void LevelSelection::handle_input() {
       // If the left mouse button is pressed, handle action based on selected
       // box.
       if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT)) {
-        m_Level->m_Id = box.m_Id;
-        m_Level->current_level = m_Level->levels[m_Level->m_Id];
+        m_Level->set_level(box.m_Id);
         mouse_pressed = true;
       }
     }
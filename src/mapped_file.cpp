@@ -0,0 +1,83 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+#include "./mapped_file.h"
+
+namespace Inversion {
+
+// ----------------------------------------------------------------------------------------------------
+MappedFile::MappedFile(const std::string &path) { open(path); }
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_Data(std::exchange(other.m_Data, nullptr)),
+      m_Size(std::exchange(other.m_Size, 0)) {}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept {
+  if (this != &other) {
+    close();
+    m_Data = std::exchange(other.m_Data, nullptr);
+    m_Size = std::exchange(other.m_Size, 0);
+  }
+  return *this;
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool MappedFile::open(const std::string &path) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+    ::close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  ::close(fd);
+
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  m_Data = static_cast<const unsigned char *>(data);
+  m_Size = static_cast<size_t>(info.st_size);
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+void MappedFile::prefetch() const {
+  if (m_Data != nullptr) {
+    madvise(const_cast<unsigned char *>(m_Data), m_Size, MADV_WILLNEED);
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+void MappedFile::close() {
+  if (m_Data != nullptr) {
+    munmap(const_cast<unsigned char *>(m_Data), m_Size);
+    m_Data = nullptr;
+    m_Size = 0;
+  }
+}
+} // namespace Inversion
@@ -0,0 +1,45 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Read-only memory mapping of a file. The mapping lives as long as the object
+// and is released on destruction.
+class MappedFile {
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept;
+  MappedFile &operator=(MappedFile &&other) noexcept;
+
+  // Map the file at the given path, replacing any previous mapping.
+  bool open(const std::string &path);
+  void close();
+
+  // Ask the kernel to read the whole file ahead in one go.
+  void prefetch() const;
+
+  bool is_open() const { return m_Data != nullptr; }
+  const unsigned char *data() const { return m_Data; }
+  size_t size() const { return m_Size; }
+
+private:
+  const unsigned char *m_Data = nullptr;
+  size_t m_Size = 0;
+};
+} // namespace Inversion
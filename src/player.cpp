@@ -36,15 +36,33 @@ void Player::set_rect(Vector2 position, Vector2 size) {
 }
 
 // ----------------------------------------------------------------------------------------------------
-void Player::handle_collision(std::vector<Rectangle> &level, Vector2 &new_pos,
-                              bool &on_ground) {
+void Player::handle_collision(const CollisionStore &collision,
+                              Vector2 &new_pos, bool &on_ground,
+                              uint8_t &touched) {
+
+  // Only look at the shapes around the player. The margin covers the small
+  // pushes made while resolving the collisions one after the other.
+  collision.query({new_pos.x - m_Player.width, new_pos.y - m_Player.height,
+                   3 * m_Player.width, 3 * m_Player.height},
+                  m_Nearby);
 
-  for (const Rectangle &obstacle : level) {
+  for (uint32_t index : m_Nearby) {
+    const Rectangle &obstacle = collision.shape(index);
+    uint8_t flags = collision.flags(index);
 
     if (new_pos.x + m_Player.width > obstacle.x &&
         new_pos.x < obstacle.x + obstacle.width &&
         new_pos.y + m_Player.height > obstacle.y &&
         new_pos.y < obstacle.y + obstacle.height) {
+      touched |= flags;
+
+      // Hazards and gravity flips are triggers, only solids push back.
+      if (!(flags & LevelFormat::TILE_SOLID)) {
+        if (flags & LevelFormat::TILE_ONE_WAY) {
+          land_on_platform(obstacle, new_pos, on_ground);
+        }
+        continue;
+      }
 
       float delta_x =
           (new_pos.x + m_Player.width / 2) - (obstacle.x + obstacle.width / 2);
@@ -89,24 +107,59 @@ void Player::handle_collision(std::vector<Rectangle> &level, Vector2 &new_pos,
   }
 }
 
+// ----------------------------------------------------------------------------------------------------
+void Player::land_on_platform(const Rectangle &platform, Vector2 &new_pos,
+                              bool &on_ground) {
+
+  // Only the side facing the gravity carries the player, and only if it was
+  // clear of the platform in the previous frame.
+  if (!m_Flipped) {
+    if (m_Velocity.y >= 0 && m_Player.y + m_Player.height <= platform.y + 1) {
+      new_pos.y = platform.y - m_Player.height;
+      m_Velocity.y = 0;
+      on_ground = true;
+    }
+  } else {
+    if (m_Velocity.y <= 0 && m_Player.y >= platform.y + platform.height - 1) {
+      new_pos.y = platform.y + platform.height;
+      m_Velocity.y = 0;
+      on_ground = true;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+void Player::respawn() {
+  m_Player.x = m_Start_Pos.x;
+  m_Player.y = m_Start_Pos.y;
+  m_Flipped = false;
+  m_InFlipZone = false;
+  m_Velocity.x = m_Velocity.y = 0;
+  m_Gravity = std::abs(m_Gravity);
+}
+
 // ----------------------------------------------------------------------------------------------------
 void Player::draw() {
   if (!m_Flipped) {
-    DrawTexturePro(AssetManager::get_texture("armor"), {0, 0, 390, 590},
-                   {m_Player.x - 18, m_Player.y + 30, 78, 118}, {0, 0}, 0,
-                   WHITE);
+    DrawTexturePro(
+        AssetManager::get_texture(TextureId::ARMOR),
+        AssetManager::get_source(TextureId::ARMOR, {0, 0, 390, 590}),
+        {m_Player.x - 18, m_Player.y + 30, 78, 118}, {0, 0}, 0, WHITE);
     switch (m_EmotionState) {
     case EmotionStates::HAPPY:
-      DrawTexture(AssetManager::get_texture("happy"), m_Player.x - 10,
-                  m_Player.y - 8, WHITE);
+      DrawTextureRec(AssetManager::get_texture(TextureId::HAPPY),
+                     AssetManager::get_source(TextureId::HAPPY),
+                     {m_Player.x - 10, m_Player.y - 8}, WHITE);
       break;
     case EmotionStates::SAD:
-      DrawTexture(AssetManager::get_texture("sad"), m_Player.x - 10,
-                  m_Player.y - 8, WHITE);
+      DrawTextureRec(AssetManager::get_texture(TextureId::SAD),
+                     AssetManager::get_source(TextureId::SAD),
+                     {m_Player.x - 10, m_Player.y - 8}, WHITE);
       break;
     case EmotionStates::FEAR:
-      DrawTexture(AssetManager::get_texture("fear"), m_Player.x - 10,
-                  m_Player.y - 8, WHITE);
+      DrawTextureRec(AssetManager::get_texture(TextureId::FEAR),
+                     AssetManager::get_source(TextureId::FEAR),
+                     {m_Player.x - 10, m_Player.y - 8}, WHITE);
       break;
     default:
       throw std::runtime_error("Emotion state invalid!\n");
@@ -116,25 +169,29 @@ void Player::draw() {
   // Flip the sprites and adjust the positions.
   else {
     DrawTexturePro(
-        AssetManager::get_texture("armor"), {0, 0, 390, 590},
+        AssetManager::get_texture(TextureId::ARMOR),
+        AssetManager::get_source(TextureId::ARMOR, {0, 0, 390, 590}),
         {m_Player.x + 55, m_Player.y + m_Player.height - 30, 78, 118}, {0, 0},
         180, WHITE);
     switch (m_EmotionState) {
     case EmotionStates::HAPPY:
       DrawTexturePro(
-          AssetManager::get_texture("happy"), {0, 0, 64, 64},
+          AssetManager::get_texture(TextureId::HAPPY),
+          AssetManager::get_source(TextureId::HAPPY, {0, 0, 64, 64}),
           {m_Player.x + 50, m_Player.y + m_Player.height + 10, 64, 64}, {0, 0},
           180, WHITE);
       break;
     case EmotionStates::SAD:
       DrawTexturePro(
-          AssetManager::get_texture("sad"), {0, 0, 64, 64},
+          AssetManager::get_texture(TextureId::SAD),
+          AssetManager::get_source(TextureId::SAD, {0, 0, 64, 64}),
           {m_Player.x + 50, m_Player.y + m_Player.height + 10, 64, 64}, {0, 0},
           180, WHITE);
       break;
     case EmotionStates::FEAR:
       DrawTexturePro(
-          AssetManager::get_texture("fear"), {0, 0, 64, 64},
+          AssetManager::get_texture(TextureId::FEAR),
+          AssetManager::get_source(TextureId::FEAR, {0, 0, 64, 64}),
           {m_Player.x + 50, m_Player.y + m_Player.height + 10, 64, 64}, {0, 0},
           180, WHITE);
       break;
@@ -150,6 +207,8 @@ void Player::set_position(Vector2 position) {
   m_Player.y = m_Start_Pos.y = position.y;
 }
 
+Vector2 Player::get_position() { return {m_Player.x, m_Player.y}; }
+
 // ----------------------------------------------------------------------------------------------------
 void Player::move() {
 
@@ -166,14 +225,12 @@ void Player::move() {
     direction -= 1;
   }
 
-  // Reset position if out of bounds
-  if (m_Player.x <= -m_Player.width || m_Player.x >= 1920 || m_Player.y < 0 ||
-      m_Player.y >= 1080) {
-    m_Player.x = m_Start_Pos.x;
-    m_Player.y = m_Start_Pos.y;
-    m_Flipped = false;
-    m_Velocity.x = m_Velocity.y = 0;
-    m_Gravity = std::abs(m_Gravity);
+  // Reset position if out of the level.
+  const Rectangle &bounds = m_Level->current_level->bounds;
+  if (m_Player.x <= bounds.x - m_Player.width ||
+      m_Player.x >= bounds.x + bounds.width || m_Player.y < bounds.y ||
+      m_Player.y >= bounds.y + bounds.height) {
+    respawn();
   }
 
   // Determine if the player is on the ground before processing movement and
@@ -181,7 +238,9 @@ void Player::move() {
   Vector2 new_pos = {m_Player.x + m_Velocity.x * delta,
                      m_Player.y + m_Velocity.y * delta};
   bool on_ground = false;
-  handle_collision(m_Level->current_level.collision_rects, new_pos, on_ground);
+  uint8_t touched = 0;
+  handle_collision(*m_Level->current_level->collision, new_pos, on_ground,
+                   touched);
 
   // Gravity flipping
   if (want_flip &&
@@ -225,7 +284,7 @@ void Player::move() {
     break;
 
   case ActorStates::JUMP_START:
-    PlaySound(AssetManager::get_sound("jump"));
+    PlaySound(AssetManager::get_sound(SoundId::JUMP));
     m_MovementState =
         (m_Velocity.y <= 0) ? ActorStates::JUMP_UP : ActorStates::FALL;
     break;
@@ -246,21 +305,38 @@ void Player::move() {
   m_Velocity.y += m_Gravity * delta;
 
   // Update player's position after handling collision
-  handle_collision(m_Level->current_level.collision_rects, new_pos, on_ground);
+  touched = 0;
+  handle_collision(*m_Level->current_level->collision, new_pos, on_ground,
+                   touched);
+
+  // Hazards send the player back to the start of the level.
+  if (touched & LevelFormat::TILE_HAZARD) {
+    respawn();
+    return;
+  }
 
-  if (m_Player.x >= 1770 && m_Player.x <= 1790 && m_Player.y >= 300 &&
-      m_Player.y <= 320) {
-    // Reset player to start.
-    new_pos.x = m_Player.x = m_Start_Pos.x;
-    new_pos.y = m_Player.y = m_Start_Pos.y;
+  // Gravity flip zones flip the player once when entering them.
+  bool in_flip_zone = touched & LevelFormat::TILE_GRAVITY_FLIP;
+  if (in_flip_zone && !m_InFlipZone) {
+    m_Flipped = !m_Flipped;
+    m_Gravity = -m_Gravity;
+  }
+  m_InFlipZone = in_flip_zone;
 
-    if (m_Level->m_Id == 15) {
+  Rectangle flag = m_Level->current_level->flag_coords;
+  if (m_Player.x >= flag.x - 10 && m_Player.x <= flag.x + 10 &&
+      m_Player.y >= flag.y - 80 && m_Player.y <= flag.y - 60) {
+    if (m_Level->m_Id + 1 == m_Level->level_count()) {
       m_Level->finished = true;
+      m_Level->set_level(m_Level->m_Id);
     } else {
-      m_Level->m_Id++;
+      m_Level->set_level(m_Level->m_Id + 1);
     }
-    m_Level->set_level(m_Level->m_Id);
-    PlaySound(AssetManager::get_sound("win"));
+    PlaySound(AssetManager::get_sound(SoundId::WIN));
+
+    // Reset player to the start of the new level.
+    set_position(m_Level->current_level->spawn);
+    new_pos = {m_Player.x, m_Player.y};
   }
 
   if (on_ground) {
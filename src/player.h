@@ -43,12 +43,23 @@ public:
   void set_position(Vector2 position);
   // Retrieve current player position.
   Vector2 get_position();
+  // Retrieve the area the player covers.
+  Rectangle get_rect() const { return m_Player; }
 
 private:
-  // Handles collision between the player and the environment.
-  void handle_collision(std::vector<Rectangle> &level, Vector2 &new_pos,
+  // Handles collision between the player and the environment. The flags of
+  // every shape the player overlaps are collected in touched.
+  void handle_collision(const CollisionStore &collision, Vector2 &new_pos,
+                        bool &on_ground, uint8_t &touched);
+
+  // Stands the player on a one-way platform when coming from above it (below
+  // it when flipped).
+  void land_on_platform(const Rectangle &platform, Vector2 &new_pos,
                         bool &on_ground);
 
+  // Put the player back to the start of the level.
+  void respawn();
+
   // Make the player happy initially.
   EmotionStates m_EmotionState = EmotionStates::HAPPY;
 
@@ -60,6 +71,10 @@ private:
   // Checks if player is flipped.
   bool m_Flipped = false;
 
+  // Checks if the player is inside a gravity flip zone, so that it flips
+  // only once on entering.
+  bool m_InFlipZone = false;
+
   // Start with an idle animation.
   ActorStates m_MovementState = ActorStates::IDLE;
 
@@ -87,5 +102,8 @@ private:
 
   // Stores level info such that the player can collide with surroundings.
   LevelManager *m_Level;
+
+  // Shapes near the player, reused between collision queries.
+  std::vector<uint32_t> m_Nearby;
 };
 } // namespace Inversion
@@ -0,0 +1,115 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include "./texture_atlas.h"
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+namespace Inversion {
+
+// ----------------------------------------------------------------------------------------------------
+// Place the sprites left to right in rows as high as their first sprite, in
+// the given order. Returns the height used or 0 if a sprite is wider than the
+// page.
+static int pack_shelves(std::vector<AtlasSprite> &sprites,
+                        const std::vector<size_t> &order, int width) {
+  int x = 0, y = 0, row_height = 0;
+  for (size_t index : order) {
+    AtlasSprite &sprite = sprites[index];
+    int sprite_width = sprite.image.width + 2 * ATLAS_PADDING;
+    if (sprite_width > width) {
+      return 0;
+    }
+    if (x + sprite_width > width) {
+      x = 0;
+      y += row_height;
+      row_height = 0;
+    }
+    sprite.source = {static_cast<float>(x + ATLAS_PADDING),
+                     static_cast<float>(y + ATLAS_PADDING),
+                     static_cast<float>(sprite.image.width),
+                     static_cast<float>(sprite.image.height)};
+    x += sprite_width;
+    row_height = std::max(row_height, sprite.image.height + 2 * ATLAS_PADDING);
+  }
+  return y + row_height;
+}
+
+// ----------------------------------------------------------------------------------------------------
+Image pack_atlas(std::vector<AtlasSprite> &sprites) {
+  // Pack the tallest sprites first and use the page width that wastes the
+  // least area.
+  std::vector<size_t> order(sprites.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return sprites[a].image.height > sprites[b].image.height;
+  });
+
+  int width = 0;
+  int height = 0;
+  for (int candidate = 64; candidate <= ATLAS_MAX_SIZE; candidate *= 2) {
+    int candidate_height = pack_shelves(sprites, order, candidate);
+    if (candidate_height > 0 && candidate_height <= ATLAS_MAX_SIZE &&
+        (width == 0 || candidate * candidate_height < width * height)) {
+      width = candidate;
+      height = candidate_height;
+    }
+  }
+  if (width == 0) {
+    return {};
+  }
+  pack_shelves(sprites, order, width);
+
+  Image page = GenImageColor(width, height, BLANK);
+  for (const auto &sprite : sprites) {
+    Rectangle source = {0, 0, sprite.source.width, sprite.source.height};
+    ImageDraw(&page, sprite.image, source, sprite.source, WHITE);
+  }
+  return page;
+}
+
+// ----------------------------------------------------------------------------------------------------
+std::string describe_atlas(const std::vector<const char *> &names,
+                           const std::vector<AtlasSprite> &sprites) {
+  std::ostringstream description;
+  for (size_t i = 0; i < names.size() && i < sprites.size(); ++i) {
+    const Rectangle &source = sprites[i].source;
+    description << names[i] << ' ' << source.x << ' ' << source.y << ' '
+                << source.width << ' ' << source.height << '\n';
+  }
+  return description.str();
+}
+
+// ----------------------------------------------------------------------------------------------------
+bool read_atlas(std::string_view description,
+                const std::vector<const char *> &names,
+                std::vector<Rectangle> &sources) {
+  std::unordered_map<std::string, Rectangle> placed;
+  std::istringstream lines{std::string(description)};
+  std::string name;
+  Rectangle source;
+  while (lines >> name >> source.x >> source.y >> source.width >>
+         source.height) {
+    placed[name] = source;
+  }
+
+  sources.clear();
+  for (const char *sprite : names) {
+    auto found = placed.find(sprite);
+    if (found == placed.end()) {
+      return false;
+    }
+    sources.push_back(found->second);
+  }
+  return true;
+}
+} // namespace Inversion
@@ -0,0 +1,84 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include "raylib.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Transparent border around every sprite on an atlas page, so filtering
+// doesn't pick up the neighbouring sprites.
+constexpr int ATLAS_PADDING = 2;
+
+// Largest page width and height.
+constexpr int ATLAS_MAX_SIZE = 4096;
+
+// ----------------------------------------------------------------------------------------------------
+// Sprites drawn together are packed onto one page. The cooker packs the pages
+// ahead of time, the asset manager packs a page itself if there is no cooked
+// one.
+struct AtlasEntry {
+  size_t page;
+  // Path of the sprite relative to the asset directory.
+  const char *sprite;
+};
+
+// Pages by index, relative to the cooked asset directory. Every page is an
+// image and a description of the same name.
+constexpr const char *ATLAS_PAGES[] = {"Atlas/game", "Atlas/end"};
+constexpr size_t ATLAS_PAGE_COUNT = 2;
+
+// The game page holds the player, the armor and the flag, the end page the
+// fireworks.
+constexpr AtlasEntry ATLAS_ENTRIES[] = {
+    {0, "Sprites/free-emojis-pixelart/emojis-x2-64x64/E17.png"},
+    {0, "Sprites/free-emojis-pixelart/emojis-x2-64x64/E5.png"},
+    {0, "Sprites/free-emojis-pixelart/emojis-x2-64x64/E4.png"},
+    {0, "Sprites/free-emojis-pixelart/emojis-x2-64x64/E37.png"},
+    {0, "Sprites/free-emojis-pixelart/emojis-x2-64x64/E13.png"},
+    {0, "Sprites/Armorstand.png"},
+    {0, "Sprites/flag.png"},
+    {1, "Sprites/yellow/1.png"},
+    {1, "Sprites/yellow/2.png"},
+    {1, "Sprites/yellow/3.png"},
+    {1, "Sprites/yellow/4.png"},
+    {1, "Sprites/yellow/5.png"},
+    {1, "Sprites/yellow/6.png"},
+    {1, "Sprites/yellow/7.png"},
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Sprite to place on an atlas page, and where it was placed.
+struct AtlasSprite {
+  Image image;
+  Rectangle source;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Pack the sprites into one RGBA page and set their source rectangles on it.
+// The images of the sprites are left untouched. Returns an empty image if
+// the sprites don't fit onto a page.
+Image pack_atlas(std::vector<AtlasSprite> &sprites);
+
+// Describe where the named sprites were placed on a page, one "<sprite> <x>
+// <y> <width> <height>" line per sprite.
+std::string describe_atlas(const std::vector<const char *> &names,
+                           const std::vector<AtlasSprite> &sprites);
+
+// Read the source rectangles of the named sprites from a page description.
+// Returns false if one of them isn't on the page.
+bool read_atlas(std::string_view description,
+                const std::vector<const char *> &names,
+                std::vector<Rectangle> &sources);
+} // namespace Inversion
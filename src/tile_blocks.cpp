@@ -0,0 +1,53 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include "./tile_blocks.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+namespace Inversion {
+
+// ----------------------------------------------------------------------------------------------------
+void TileBlocks::build(const TileBatch &batch) {
+  const auto &tiles = batch.tiles;
+  auto block = [&](uint32_t i) {
+    return std::make_pair(block_of(tiles[i].row), block_of(tiles[i].col));
+  };
+
+  m_Order.resize(tiles.size());
+  std::iota(m_Order.begin(), m_Order.end(), 0);
+  std::stable_sort(m_Order.begin(), m_Order.end(),
+                   [&](uint32_t a, uint32_t b) { return block(a) < block(b); });
+
+  m_Blocks.clear();
+  for (uint32_t i = 0; i < m_Order.size(); ++i) {
+    auto [y, x] = block(m_Order[i]);
+    if (m_Blocks.empty() || m_Blocks.back().x != x || m_Blocks.back().y != y) {
+      m_Blocks.push_back({x, y, i});
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+size_t TileBlocks::find(int32_t x, int32_t y) const {
+  auto before = [](const Block &block, std::pair<int32_t, int32_t> at) {
+    return std::make_pair(block.y, block.x) < at;
+  };
+  return std::lower_bound(m_Blocks.begin(), m_Blocks.end(),
+                          std::make_pair(y, x), before) -
+         m_Blocks.begin();
+}
+
+uint32_t TileBlocks::start(size_t block) const {
+  return block < m_Blocks.size() ? m_Blocks[block].first
+                                 : static_cast<uint32_t>(m_Order.size());
+}
+} // namespace Inversion
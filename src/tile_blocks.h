@@ -0,0 +1,93 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+
+#include "./tile_mapping.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// The tiles of a batch grouped into square blocks of cells, so that only the
+// blocks in view are drawn. Tiles keep their batch order within a block and
+// merged tiles never cross blocks, so overlapping tiles stay in order.
+class TileBlocks {
+public:
+  // Side length of a block in cells.
+  static constexpr int32_t size = 16;
+
+  // Block coordinate of a cell coordinate.
+  static int32_t block_of(int32_t cell) {
+    return cell >= 0 ? cell / size : (cell + 1) / size - 1;
+  }
+
+  void build(const TileBatch &batch);
+
+  // Indices of the tiles of the batch, grouped by block in row-major block
+  // order.
+  const std::vector<uint32_t> &order() const { return m_Order; }
+
+  // Call draw(first, count) with the range of the order holding the tiles of
+  // the blocks in view, once per row of blocks.
+  template <typename Draw>
+  void for_each_visible(Rectangle view, Vector2 screen_tile_size,
+                        Draw draw) const;
+
+private:
+  struct Block {
+    int32_t x;
+    int32_t y;
+    // First tile of the block in the order.
+    uint32_t first;
+  };
+
+  // Index of the first block at or after the given block coordinates.
+  size_t find(int32_t x, int32_t y) const;
+  // Position in the order where the tiles of a block start.
+  uint32_t start(size_t block) const;
+
+  std::vector<Block> m_Blocks;
+  std::vector<uint32_t> m_Order;
+};
+
+// ----------------------------------------------------------------------------------------------------
+template <typename Draw>
+void TileBlocks::for_each_visible(Rectangle view, Vector2 screen_tile_size,
+                                  Draw draw) const {
+  if (m_Blocks.empty() || screen_tile_size.x <= 0 ||
+      screen_tile_size.y <= 0) {
+    return;
+  }
+  Vector2 block_size = {screen_tile_size.x * size, screen_tile_size.y * size};
+  auto first_block = [](float position, float size) {
+    return static_cast<int32_t>(std::floor(position / size));
+  };
+  int32_t left = first_block(view.x, block_size.x);
+  int32_t right = first_block(view.x + view.width, block_size.x);
+  int32_t top =
+      std::max(first_block(view.y, block_size.y), m_Blocks.front().y);
+  int32_t bottom = std::min(first_block(view.y + view.height, block_size.y),
+                            m_Blocks.back().y);
+
+  for (int32_t row = top; row <= bottom; ++row) {
+    uint32_t first = start(find(left, row));
+    uint32_t last = start(find(right + 1, row));
+    if (first < last) {
+      draw(first, last - first);
+    }
+  }
+}
+} // namespace Inversion
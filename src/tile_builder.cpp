@@ -0,0 +1,380 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "./tile_blocks.h"
+#include "./tile_builder.h"
+
+namespace Inversion {
+
+using LevelFormat::ChunkRecord;
+using LevelFormat::Header;
+using LevelFormat::LayerRole;
+using LevelFormat::LevelView;
+
+// Pack the tile of a gid at the given grid position. Fails if the tileset
+// index or the position don't fit into a packed tile.
+static bool pack_tile(int32_t col, int32_t row, uint32_t gid,
+                      PackedTile &tile) {
+  // Adjust for Tiled's 1-based indexing.
+  uint32_t id = (gid & 0x0fffffff) - 1;
+  if (id > PackedTile::ID_MASK ||
+      col < std::numeric_limits<int16_t>::min() ||
+      col > std::numeric_limits<int16_t>::max() ||
+      row < std::numeric_limits<int16_t>::min() ||
+      row > std::numeric_limits<int16_t>::max()) {
+    std::cerr << "Cannot pack tile " << gid << " at " << col << ", " << row
+              << '\n';
+    return false;
+  }
+
+  // The flip bits move from the top of the gid to the top of the tile field.
+  tile = {static_cast<int16_t>(col), static_cast<int16_t>(row),
+          static_cast<uint16_t>((gid >> 16 & ~PackedTile::ID_MASK) | id), 1,
+          1};
+  return true;
+}
+
+// Screen area covered by the cell at the given grid position.
+static Rectangle cell_bounds(const Header &header, int32_t col, int32_t row) {
+  // TileMap and screen have a 1:4 ratio.
+  float screen_tile_width = 4.f * header.tile_width;
+  float screen_tile_height = 4.f * header.tile_height;
+  return {col * screen_tile_width, row * screen_tile_height, screen_tile_width,
+          screen_tile_height};
+}
+
+// Flags of the collision shape of a cell, 0 if it has none. Maps with a
+// collision object layer take their solid shapes from the objects instead.
+static uint8_t shape_flags(const LevelView &view, size_t cell) {
+  uint8_t flags = view.cell_flags[cell];
+  if (view.header.shape_count > 0) {
+    flags &= ~LevelFormat::TILE_SOLID;
+  }
+  return flags;
+}
+
+// Collision shapes of a finite level: the collision objects followed by the
+// flagged cells. Cells are classified when the level is compiled.
+static std::shared_ptr<const CollisionStore>
+build_collision(const LevelView &view) {
+  const Header &header = view.header;
+  std::vector<Rectangle> shapes(view.shapes, view.shapes + header.shape_count);
+  std::vector<uint8_t> flags(shapes.size(), LevelFormat::TILE_SOLID);
+
+  size_t cells = LevelFormat::cell_count(header);
+  for (size_t cell = 0; cell < cells; ++cell) {
+    if (uint8_t cell_flags = shape_flags(view, cell)) {
+      shapes.push_back(
+          cell_bounds(header, cell % header.width, cell / header.width));
+      flags.push_back(cell_flags);
+    }
+  }
+  return std::make_shared<CollisionStore>(std::move(shapes), std::move(flags));
+}
+
+// ----------------------------------------------------------------------------------------------------
+TileGeometry tile_geometry(const Header &header) {
+  Rectangle cell = cell_bounds(header, 0, 0);
+  TileGeometry geometry = {{static_cast<float>(header.tile_width),
+                            static_cast<float>(header.tile_height)},
+                           {cell.width, cell.height},
+                           header.tileset_columns,
+                           {}};
+
+  // The flag table has an entry for every tile of the map.
+  uint32_t tile_count =
+      std::min<uint32_t>(header.tile_type_count, PackedTile::ID_MASK + 1);
+  for (uint32_t i = 0; i < tile_count; ++i) {
+    geometry.sources.push_back(
+        {static_cast<float>(i % header.tileset_columns * header.tile_width),
+         static_cast<float>(i / header.tileset_columns * header.tile_height)});
+  }
+  return geometry;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Add the tiles of a grid of cells to the batch. Empty cells are skipped. If
+// merge is set, fill tiles are merged into the largest rectangles of the same
+// tile, growing right and then down within their block, and drawn as one
+// stretched tile. Fill tiles look the same flipped, so their flips are
+// dropped. Returns the grid index of every added tile, a merged tile has the
+// index of its top left cell. Tiles that can't be packed are skipped.
+static std::vector<uint32_t> add_cells(TileBatch &batch, const LevelView &view,
+                                       const uint32_t *gids, uint32_t width,
+                                       uint32_t height, int32_t origin_col,
+                                       int32_t origin_row, bool merge) {
+  std::vector<uint32_t> added;
+  std::vector<bool> merged(merge ? static_cast<size_t>(width) * height : 0);
+
+  for (uint32_t cell = 0; cell < width * height; ++cell) {
+    uint32_t gid = gids[cell];
+    if (gid == 0 || (merge && merged[cell])) {
+      continue;
+    }
+    uint32_t col = cell % width;
+    uint32_t row = cell / width;
+
+    PackedTile tile;
+    if (!pack_tile(origin_col + col, origin_row + row, gid, tile)) {
+      continue;
+    }
+    if (!merge || !(view.flags_of(gid) & LevelFormat::TILE_FILL)) {
+      batch.tiles.push_back(tile);
+      added.push_back(cell);
+      continue;
+    }
+
+    // Merged tiles stay within the block of their top left cell, which keeps
+    // them small enough for the size fields of the packed tile.
+    static_assert(TileBlocks::size <= std::numeric_limits<uint8_t>::max(),
+                  "Blocks should fit into a packed tile");
+    uint32_t max_width =
+        (TileBlocks::block_of(tile.col) + 1) * TileBlocks::size - tile.col;
+    uint32_t max_height =
+        (TileBlocks::block_of(tile.row) + 1) * TileBlocks::size - tile.row;
+    auto same = [&](uint32_t c, uint32_t r) {
+      size_t other = static_cast<size_t>(r) * width + c;
+      return !merged[other] &&
+             (gids[other] & 0x0fffffff) == (gid & 0x0fffffff);
+    };
+    uint32_t run_width = 1;
+    while (col + run_width < width && run_width < max_width &&
+           same(col + run_width, row)) {
+      run_width++;
+    }
+    uint32_t run_height = 1;
+    for (bool full = true;
+         row + run_height < height && run_height < max_height && full;) {
+      for (uint32_t c = col; c < col + run_width && full; ++c) {
+        full = same(c, row + run_height);
+      }
+      if (full) {
+        run_height++;
+      }
+    }
+    for (uint32_t r = row; r < row + run_height; ++r) {
+      for (uint32_t c = col; c < col + run_width; ++c) {
+        merged[static_cast<size_t>(r) * width + c] = true;
+      }
+    }
+
+    tile.tile &= PackedTile::ID_MASK;
+    tile.columns = static_cast<uint8_t>(run_width);
+    tile.rows = static_cast<uint8_t>(run_height);
+    batch.tiles.push_back(tile);
+    added.push_back(cell);
+  }
+  return added;
+}
+
+// ----------------------------------------------------------------------------------------------------
+TileMapping build_tile_mapping(const LevelView &view) {
+  const Header &header = view.header;
+  TileMapping level;
+
+  size_t cells = LevelFormat::cell_count(header);
+  level.gids.assign(view.gids, view.gids + LevelFormat::tile_count(header));
+  level.tile_flags.assign(view.tile_flags,
+                          view.tile_flags + header.tile_type_count);
+
+  for (uint32_t layer = 0; layer < header.layer_count; ++layer) {
+    LayerRole role = view.layers[layer].role;
+    level.layer_roles.push_back(role);
+    TileBatch &batch = level.batch(role);
+
+    // Animated tiles change their frame per tile, they aren't merged.
+    for (uint32_t cell :
+         add_cells(batch, view, view.gids + layer * cells, header.width,
+                   header.height, 0, 0, role != LayerRole::ANIMATED)) {
+      batch.indices.push_back(static_cast<uint32_t>(layer * cells + cell));
+    }
+  }
+
+  level.collision = build_collision(view);
+  level.animations = build_animations(view);
+  level.flag_coords = {header.flag_x, header.flag_y};
+  level.flag_flipped = false;
+  level.spawn = {header.spawn_x, header.spawn_y};
+  level.columns = header.width;
+  level.rows = header.height;
+  level.geometry = tile_geometry(header);
+  level.bounds = {0, 0, header.width * level.geometry.screen_tile_size.x,
+                  header.height * level.geometry.screen_tile_size.y};
+
+  return level;
+}
+
+// ----------------------------------------------------------------------------------------------------
+size_t patch_tile_mapping(TileMapping &level, const LevelView &view) {
+  const Header &header = view.header;
+  size_t tile_count = LevelFormat::tile_count(header);
+
+  bool same_layout = level.columns == header.width &&
+                     level.rows == header.height &&
+                     level.gids.size() == tile_count &&
+                     level.layer_roles.size() == header.layer_count &&
+                     std::equal(level.layer_roles.begin(),
+                                level.layer_roles.end(), view.layers,
+                                [](LayerRole role, const auto &layer) {
+                                  return role == layer.role;
+                                });
+  // The tile geometry and the collision of unchanged cells depend on the
+  // tileset, a changed tileset rebuilds the level.
+  bool same_tileset =
+      level.geometry.tile_size.x == header.tile_width &&
+      level.geometry.tile_size.y == header.tile_height &&
+      level.geometry.tileset_columns == header.tileset_columns &&
+      level.tile_flags.size() == header.tile_type_count &&
+      std::equal(level.tile_flags.begin(), level.tile_flags.end(),
+                 view.tile_flags);
+  same_layout = same_layout && same_tileset;
+
+  std::vector<size_t> changed;
+  bool rebuild = !same_layout;
+  for (size_t index = 0; index < tile_count && same_layout; ++index) {
+    uint32_t gid = view.gids[index];
+    if (gid != level.gids[index]) {
+      // Added or removed tiles change the batches, rebuild them. So do fill
+      // tiles, which may be merged with their neighbours.
+      uint8_t fill = (view.flags_of(gid) | view.flags_of(level.gids[index])) &
+                     LevelFormat::TILE_FILL;
+      rebuild = rebuild || gid == 0 || level.gids[index] == 0 || fill;
+      changed.push_back(index);
+    }
+  }
+
+  if (rebuild) {
+    level = build_tile_mapping(view);
+    return same_layout ? changed.size() : tile_count;
+  }
+
+  size_t cells = LevelFormat::cell_count(header);
+  std::vector<size_t> changed_cells;
+
+  for (size_t index : changed) {
+    uint32_t gid = view.gids[index];
+    size_t cell = index % cells;
+    TileBatch &batch = level.batch(level.layer_roles[index / cells]);
+
+    auto slot = std::lower_bound(batch.indices.begin(), batch.indices.end(),
+                                 static_cast<uint32_t>(index)) -
+                batch.indices.begin();
+    if (!pack_tile(cell % header.width, cell / header.width, gid,
+                   batch.tiles[slot])) {
+      // The tile is skipped, which changes the batch.
+      level = build_tile_mapping(view);
+      return changed.size();
+    }
+    level.gids[index] = gid;
+
+    changed_cells.push_back(cell);
+  }
+  std::sort(changed_cells.begin(), changed_cells.end());
+  changed_cells.erase(std::unique(changed_cells.begin(), changed_cells.end()),
+                      changed_cells.end());
+
+  if (header.shape_count > 0) {
+    // Collision objects may have moved independently of the tiles.
+    level.collision = build_collision(view);
+  } else if (!changed_cells.empty()) {
+    // Swap out the collision shapes of the changed cells only.
+    auto is_changed = [&](const Rectangle &rect) {
+      size_t col = rect.x / rect.width;
+      size_t row = rect.y / rect.height;
+      return std::binary_search(changed_cells.begin(), changed_cells.end(),
+                                row * header.width + col);
+    };
+    std::vector<Rectangle> shapes;
+    std::vector<uint8_t> flags;
+    for (uint32_t i = 0; i < level.collision->size(); ++i) {
+      if (!is_changed(level.collision->shape(i))) {
+        shapes.push_back(level.collision->shape(i));
+        flags.push_back(level.collision->flags(i));
+      }
+    }
+
+    for (size_t cell : changed_cells) {
+      if (uint8_t cell_flags = shape_flags(view, cell)) {
+        shapes.push_back(
+            cell_bounds(header, cell % header.width, cell / header.width));
+        flags.push_back(cell_flags);
+      }
+    }
+    level.collision =
+        std::make_shared<CollisionStore>(std::move(shapes), std::move(flags));
+  }
+
+  level.animations = build_animations(view);
+  level.flag_coords = {header.flag_x, header.flag_y};
+  level.spawn = {header.spawn_x, header.spawn_y};
+  return changed.size();
+}
+
+// ----------------------------------------------------------------------------------------------------
+std::vector<TileAnimation> build_animations(const LevelView &view) {
+  const Header &header = view.header;
+  std::vector<TileAnimation> animations;
+
+  for (uint32_t i = 0; i < header.frame_count; ++i) {
+    const auto &frame = view.frames[i];
+    if (animations.empty() || animations.back().tile_id != frame.tile_id) {
+      animations.push_back({frame.tile_id, {}, {}, 0});
+    }
+
+    TileAnimation &animation = animations.back();
+    animation.coords.push_back(
+        {static_cast<float>(frame.frame_id % header.tileset_columns *
+                            header.tile_width),
+         static_cast<float>(frame.frame_id / header.tileset_columns *
+                            header.tile_height)});
+    animation.durations.push_back(frame.duration_ms / 1000.f);
+    animation.length += frame.duration_ms / 1000.f;
+  }
+  return animations;
+}
+
+// ----------------------------------------------------------------------------------------------------
+TileMapping build_chunk(const LevelView &view, uint32_t chunk) {
+  const Header &header = view.header;
+  const ChunkRecord &record = view.chunks[chunk];
+  TileMapping level;
+  level.geometry = tile_geometry(header);
+
+  size_t cells = LevelFormat::cell_count(header);
+  size_t chunk_tiles = header.chunk_size * header.chunk_size;
+  size_t first = chunk * chunk_tiles;
+
+  for (uint32_t layer = 0; layer < header.layer_count; ++layer) {
+    LayerRole role = view.layers[layer].role;
+    add_cells(level.batch(role), view, view.gids + layer * cells + first,
+              header.chunk_size, header.chunk_size, record.x, record.y,
+              role != LayerRole::ANIMATED);
+  }
+
+  // Collision objects aren't chunked, the stream shares them level-wide.
+  std::vector<Rectangle> shapes;
+  std::vector<uint8_t> flags;
+  for (size_t local = 0; local < chunk_tiles; ++local) {
+    if (uint8_t cell_flags = shape_flags(view, first + local)) {
+      int32_t col = record.x + static_cast<int32_t>(local % header.chunk_size);
+      int32_t row = record.y + static_cast<int32_t>(local / header.chunk_size);
+      shapes.push_back(cell_bounds(header, col, row));
+      flags.push_back(cell_flags);
+    }
+  }
+  level.collision =
+      std::make_shared<CollisionStore>(std::move(shapes), std::move(flags));
+  return level;
+}
+} // namespace Inversion
@@ -0,0 +1,89 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+
+#include "./level_format.h"
+#include "./tile_mapping.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Turns compiled tile grids into the render and collision data of levels.
+// ----------------------------------------------------------------------------------------------------
+// Arguments of DrawTexturePro for a single tile: the screen rectangle, the
+// tileset coordinates, the source size (negative if flipped) and the rotation.
+struct TileEntry {
+  Rectangle rect;
+  Vector2 coords;
+  float width;
+  float height;
+  float rotation;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Tile geometry of a compiled level.
+TileGeometry tile_geometry(const LevelFormat::Header &header);
+
+// ----------------------------------------------------------------------------------------------------
+// Derive the draw arguments of a packed tile. Called per tile while drawing,
+// the flips are looked up instead of branched on.
+inline TileEntry make_tile(const TileGeometry &geometry,
+                           const PackedTile &tile) {
+  // Source size signs, rotation and the horizontal offset in screen tiles
+  // by the flip bits (horizontal, vertical, diagonal). A diagonal flip is a
+  // rotation by 90 degrees with the horizontal flip inverted.
+  struct Flip {
+    float width;
+    float height;
+    float rotation;
+    float offset;
+  };
+  static constexpr Flip flips[8] = {
+      {1, 1, 0, 0},  {-1, 1, 90, 1},  {1, -1, 0, 0},  {-1, -1, 90, 1},
+      {-1, 1, 0, 0}, {1, 1, 90, 1},   {-1, -1, 0, 0}, {1, -1, 90, 1},
+  };
+  const Flip &flip = flips[tile.tile >> 13];
+  Vector2 screen_tile_size = geometry.screen_tile_size;
+
+  return {{(tile.col + flip.offset) * screen_tile_size.x,
+           tile.row * screen_tile_size.y, screen_tile_size.x * tile.columns,
+           screen_tile_size.y * tile.rows},
+          geometry.sources[tile.id()],
+          geometry.tile_size.x * flip.width,
+          geometry.tile_size.y * flip.height,
+          flip.rotation};
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Build the render and collision data of a finite level. Empty cells are
+// skipped.
+TileMapping build_tile_mapping(const LevelFormat::LevelView &view);
+
+// ----------------------------------------------------------------------------------------------------
+// Patch the tiles that differ between a built level and its new tile grid.
+// The level is rebuilt if its size, layers or tileset changed, or if tiles
+// were added or removed. Returns the number of changed tiles.
+size_t patch_tile_mapping(TileMapping &level,
+                          const LevelFormat::LevelView &view);
+
+// ----------------------------------------------------------------------------------------------------
+// Collect the tile animations of a level.
+std::vector<TileAnimation>
+build_animations(const LevelFormat::LevelView &view);
+
+// ----------------------------------------------------------------------------------------------------
+// Build the render and collision data of one chunk of an infinite level.
+TileMapping build_chunk(const LevelFormat::LevelView &view, uint32_t chunk);
+} // namespace Inversion
@@ -0,0 +1,221 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include "./tile_map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "rlgl.h"
+
+namespace Inversion {
+
+// ----------------------------------------------------------------------------------------------------
+// The gid of a cell is stored little endian in the RGBA channels, so the flip
+// bits are the top bits of alpha. Tiled flips diagonally first, then
+// horizontally and vertically, the lookup undoes them in reverse order.
+static const char *tile_map_shader = R"(#version 330
+in vec2 fragTexCoord;
+in vec4 fragColor;
+
+uniform sampler2D texture0;
+uniform sampler2D tileset;
+uniform vec4 colDiffuse;
+uniform vec2 mapSize;
+uniform vec2 tileSize;
+uniform int tilesetColumns;
+
+out vec4 finalColor;
+
+void main() {
+  vec2 cell = fragTexCoord * mapSize;
+  ivec2 position = min(ivec2(cell), ivec2(mapSize) - 1);
+  ivec4 gid = ivec4(texelFetch(texture0, position, 0) * 255.0 + 0.5);
+  int tile = gid.r | (gid.g << 8) | (gid.b << 16) | ((gid.a & 0x0f) << 24);
+  if (tile == 0) {
+    discard;
+  }
+  tile -= 1;
+
+  vec2 local = fract(cell);
+  if ((gid.a & 0x80) != 0) {
+    local.x = 1.0 - local.x;
+  }
+  if ((gid.a & 0x40) != 0) {
+    local.y = 1.0 - local.y;
+  }
+  if ((gid.a & 0x20) != 0) {
+    local = local.yx;
+  }
+
+  ivec2 size = ivec2(tileSize);
+  ivec2 origin = ivec2(tile % tilesetColumns, tile / tilesetColumns) * size;
+  ivec2 texel = origin + min(ivec2(local * tileSize), size - 1);
+  finalColor = texelFetch(tileset, texel, 0) * colDiffuse * fragColor;
+}
+)";
+
+// The shader is shared by all tile maps. The first one loaded compiles it,
+// the last one unloaded frees it.
+static Shader shared_shader = {};
+static int shader_users = 0;
+
+// ----------------------------------------------------------------------------------------------------
+bool TileMap::load() {
+  if (is_loaded()) {
+    return true;
+  }
+
+  if (shader_users == 0) {
+    // raylib falls back to its default shader if compiling fails.
+    Shader shader = LoadShaderFromMemory(nullptr, tile_map_shader);
+    if (shader.id == 0 || shader.id == rlGetShaderIdDefault()) {
+      TraceLog(LOG_WARNING, "TILEMAP: Shader not supported, drawing meshes");
+      return false;
+    }
+    shared_shader = shader;
+  }
+  shader_users++;
+
+  m_Shader = shared_shader;
+  m_TilesetLocation = GetShaderLocation(m_Shader, "tileset");
+  m_MapSizeLocation = GetShaderLocation(m_Shader, "mapSize");
+  m_TileSizeLocation = GetShaderLocation(m_Shader, "tileSize");
+  m_TilesetColumnsLocation = GetShaderLocation(m_Shader, "tilesetColumns");
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+void TileMap::update(const TileMapping &level) {
+  size_t cells = static_cast<size_t>(level.columns) * level.rows;
+
+  bool same_layout = level.columns == m_Columns && level.rows == m_Rows &&
+                     level.gids.size() == m_Gids.size() &&
+                     level.layer_roles.size() == m_Layers.size() &&
+                     std::equal(level.layer_roles.begin(),
+                                level.layer_roles.end(), m_Layers.begin(),
+                                [](TileMapping::LayerRole role,
+                                   const Layer &layer) {
+                                  return role == layer.role;
+                                });
+  m_TileSize = level.geometry.tile_size;
+  m_ScreenTileSize = level.geometry.screen_tile_size;
+  m_TilesetColumns = level.geometry.tileset_columns;
+
+  if (same_layout) {
+    // Write the runs of changed cells of every row.
+    for (size_t layer = 0; layer < m_Layers.size(); ++layer) {
+      for (uint32_t row = 0; row < m_Rows; ++row) {
+        size_t start = layer * cells + row * m_Columns;
+        for (uint32_t first = 0; first < m_Columns;) {
+          if (level.gids[start + first] == m_Gids[start + first]) {
+            ++first;
+            continue;
+          }
+          uint32_t last = first + 1;
+          while (last < m_Columns &&
+                 level.gids[start + last] != m_Gids[start + last]) {
+            ++last;
+          }
+          UpdateTextureRec(m_Layers[layer].gids,
+                           {static_cast<float>(first), static_cast<float>(row),
+                            static_cast<float>(last - first), 1},
+                           &level.gids[start + first]);
+          first = last;
+        }
+      }
+    }
+    m_Gids = level.gids;
+    return;
+  }
+
+  unload_layers();
+  if (cells == 0 || level.gids.size() != cells * level.layer_roles.size()) {
+    return;
+  }
+  m_Columns = level.columns;
+  m_Rows = level.rows;
+  m_Gids = level.gids;
+
+  for (size_t layer = 0; layer < level.layer_roles.size(); ++layer) {
+    Image image = {const_cast<uint32_t *>(&m_Gids[layer * cells]),
+                   static_cast<int>(m_Columns), static_cast<int>(m_Rows), 1,
+                   PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+    m_Layers.push_back({level.layer_roles[layer], LoadTextureFromImage(image)});
+  }
+}
+
+// ----------------------------------------------------------------------------------------------------
+void TileMap::draw(TileMapping::LayerRole role, const Texture2D &tileset,
+                   Rectangle view) const {
+  if (!is_loaded() || tileset.id == 0 || m_Columns == 0 || m_Rows == 0) {
+    return;
+  }
+
+  // Cover the cells in view only, the shader finds the cell of a fragment
+  // from its texture coordinates.
+  Vector2 map_size = {static_cast<float>(m_Columns),
+                      static_cast<float>(m_Rows)};
+  float left = std::clamp(std::floor(view.x / m_ScreenTileSize.x), 0.f,
+                          map_size.x);
+  float top = std::clamp(std::floor(view.y / m_ScreenTileSize.y), 0.f,
+                         map_size.y);
+  float right = std::clamp(
+      std::ceil((view.x + view.width) / m_ScreenTileSize.x), left, map_size.x);
+  float bottom = std::clamp(
+      std::ceil((view.y + view.height) / m_ScreenTileSize.y), top, map_size.y);
+  if (left == right || top == bottom) {
+    return;
+  }
+  int tileset_columns = static_cast<int>(m_TilesetColumns);
+  Rectangle source = {left, top, right - left, bottom - top};
+  Rectangle target = {left * m_ScreenTileSize.x, top * m_ScreenTileSize.y,
+                      source.width * m_ScreenTileSize.x,
+                      source.height * m_ScreenTileSize.y};
+
+  BeginShaderMode(m_Shader);
+  SetShaderValue(m_Shader, m_MapSizeLocation, &map_size, SHADER_UNIFORM_VEC2);
+  SetShaderValue(m_Shader, m_TileSizeLocation, &m_TileSize,
+                 SHADER_UNIFORM_VEC2);
+  SetShaderValue(m_Shader, m_TilesetColumnsLocation, &tileset_columns,
+                 SHADER_UNIFORM_INT);
+  for (const auto &layer : m_Layers) {
+    if (layer.role != role) {
+      continue;
+    }
+    // rlgl only binds the tileset for the next flush of its batch and
+    // forgets it afterwards. Every layer sets it again and is flushed right
+    // away, so a flush in between can't leave a layer without it.
+    SetShaderValueTexture(m_Shader, m_TilesetLocation, tileset);
+    DrawTexturePro(layer.gids, source, target, {0, 0}, 0, WHITE);
+    rlDrawRenderBatchActive();
+  }
+  EndShaderMode();
+}
+
+// ----------------------------------------------------------------------------------------------------
+void TileMap::unload_layers() {
+  for (const auto &layer : m_Layers) {
+    UnloadTexture(layer.gids);
+  }
+  m_Layers.clear();
+  m_Gids.clear();
+  m_Columns = m_Rows = 0;
+}
+
+void TileMap::unload() {
+  unload_layers();
+  if (is_loaded() && --shader_users == 0) {
+    UnloadShader(shared_shader);
+    shared_shader = {};
+  }
+  m_Shader = {};
+}
+} // namespace Inversion
@@ -0,0 +1,73 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+
+#include "./tile_mapping.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// Draws the tile layers of a finite level with a fragment shader. The gids of
+// every layer, flip bits included, are uploaded as an RGBA texture with one
+// texel per cell, and the shader resolves the tile, its flips and its place
+// in the tileset per pixel. A layer is drawn as one quad, whatever its number
+// of tiles. Has to be unloaded while the window is open.
+class TileMap {
+public:
+  TileMap() = default;
+  TileMap(const TileMap &) = delete;
+  TileMap &operator=(const TileMap &) = delete;
+
+  // Compile the shader, or share the one of a tile map already loaded.
+  // Returns false if the driver doesn't support it.
+  bool load();
+  bool is_loaded() const { return m_Shader.id != 0; }
+
+  // Upload the gids of the level's layers. If the grid and the layers are
+  // unchanged, only the cells that differ are written, one texel each.
+  void update(const TileMapping &level);
+
+  // Draw the cells of the layers of the given role the view overlaps, in map
+  // order.
+  void draw(TileMapping::LayerRole role, const Texture2D &tileset,
+            Rectangle view) const;
+
+  // Free the gid textures, and the shader if no other tile map uses it.
+  void unload();
+
+private:
+  void unload_layers();
+
+  Shader m_Shader = {};
+  int m_TilesetLocation = -1;
+  int m_MapSizeLocation = -1;
+  int m_TileSizeLocation = -1;
+  int m_TilesetColumnsLocation = -1;
+
+  // Gid texture of every layer, in map order.
+  struct Layer {
+    TileMapping::LayerRole role;
+    Texture2D gids;
+  };
+  std::vector<Layer> m_Layers;
+
+  // Copy of the uploaded gids, to find the cells that changed.
+  std::vector<uint32_t> m_Gids;
+  uint32_t m_Columns = 0;
+  uint32_t m_Rows = 0;
+  Vector2 m_TileSize = {};
+  Vector2 m_ScreenTileSize = {};
+  uint32_t m_TilesetColumns = 0;
+};
+} // namespace Inversion
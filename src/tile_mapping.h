@@ -0,0 +1,144 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include "raylib.h"
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "./collision_store.h"
+#include "./level_format.h"
+
+namespace Inversion {
+class ChunkStore;
+
+// ----------------------------------------------------------------------------------------------------
+// A tile of a batch in 8 bytes. Its source and screen rectangles are derived
+// from the tile geometry of the level when it is drawn, see make_tile.
+struct PackedTile {
+  // The tile field holds the 0-based tileset index in the low bits and the
+  // flip bits of the gid in the top three.
+  static constexpr uint16_t ID_MASK = 0x1fff;
+  static constexpr uint16_t FLIP_HORIZONTAL = 0x8000;
+  static constexpr uint16_t FLIP_VERTICAL = 0x4000;
+  static constexpr uint16_t FLIP_DIAGONAL = 0x2000;
+
+  // Grid position of the top left cell.
+  int16_t col;
+  int16_t row;
+  uint16_t tile;
+  // Cells covered by a merged fill tile, 1 by 1 otherwise.
+  uint8_t columns;
+  uint8_t rows;
+
+  uint32_t id() const { return tile & ID_MASK; }
+};
+static_assert(sizeof(PackedTile) == 8, "PackedTile should stay 8 bytes");
+static_assert(PackedTile::ID_MASK == LevelFormat::MAX_TILE_ID &&
+                  std::numeric_limits<int16_t>::min() ==
+                      LevelFormat::MIN_GRID_POSITION &&
+                  std::numeric_limits<int16_t>::max() ==
+                      LevelFormat::MAX_GRID_POSITION,
+              "Every tile of a level should fit into a packed tile");
+
+// ----------------------------------------------------------------------------------------------------
+// Sizes the rectangles of packed tiles are derived from.
+struct TileGeometry {
+  // Size of a tile in the tileset and on screen.
+  Vector2 tile_size = {};
+  Vector2 screen_tile_size = {};
+  // Number of tiles per row of the tileset.
+  uint32_t tileset_columns = 0;
+  // Tileset coordinates of the tiles by tileset index, so drawing looks them
+  // up instead of dividing per tile.
+  std::vector<Vector2> sources;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Render data of the tiles of one layer role, drawn as one batch.
+struct TileBatch {
+  std::vector<PackedTile> tiles;
+
+  // Index of each tile in the level's gids, in ascending order. Only set for
+  // finite levels, where it is used to patch single tiles.
+  std::vector<uint32_t> indices;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Frames of an animated tile from the tileset.
+struct TileAnimation {
+  // 0-based tileset index of the animated tile.
+  uint32_t tile_id;
+  // Tileset coordinates and duration in seconds of each frame.
+  std::vector<Vector2> coords;
+  std::vector<float> durations;
+  float length;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Render and collision data of a single level.
+struct TileMapping {
+  using LayerRole = LevelFormat::LayerRole;
+
+  // Tiles grouped by the role of their layer. Static roles never change
+  // while the level is played, only the animated batch is updated per frame.
+  std::array<TileBatch, LevelFormat::LAYER_ROLE_COUNT> batches;
+
+  // Shapes the player collides with. Shared between snapshots of a level,
+  // it is replaced rather than modified.
+  std::shared_ptr<const CollisionStore> collision =
+      std::make_shared<CollisionStore>();
+
+  // Role of each tile layer in map order.
+  std::vector<LayerRole> layer_roles;
+
+  // Animations of the tileset, sorted by tile.
+  std::vector<TileAnimation> animations;
+
+  // Gids of all layers, one after the other.
+  std::vector<uint32_t> gids;
+
+  // TileFlag bits of the tileset tiles, kept to notice changed tile
+  // properties when the level is patched.
+  std::vector<uint8_t> tile_flags;
+
+  // Size of the tile grid.
+  uint32_t columns = 0;
+  uint32_t rows = 0;
+
+  // Area covered by the cells of the level in screen coordinates. The camera
+  // and the player stay within it.
+  Rectangle bounds = {};
+
+  TileGeometry geometry;
+
+  // Tile storage of infinite levels, which are streamed in chunks around the
+  // player instead of being built up front.
+  std::shared_ptr<const ChunkStore> chunks;
+
+  bool flag_flipped;
+  Rectangle flag_coords;
+  Vector2 spawn;
+
+  TileBatch &batch(LayerRole role) {
+    return batches[static_cast<size_t>(role)];
+  }
+  const TileBatch &batch(LayerRole role) const {
+    return batches[static_cast<size_t>(role)];
+  }
+};
+
+// Shared, read-only reference to a loaded level. Copying a handle never
+// copies the level itself.
+using LevelHandle = std::shared_ptr<const TileMapping>;
+} // namespace Inversion
@@ -0,0 +1,171 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#include "./tile_mesh.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "raymath.h"
+#include "rlgl.h"
+
+namespace Inversion {
+
+// ----------------------------------------------------------------------------------------------------
+// Compute the vertices DrawTexturePro would emit for the tile: a negative
+// source width or height flips the tile, the rotation turns it around the top
+// left corner of its rectangle.
+void TileMesh::tile_vertices(const TileEntry &tile, const Texture2D &texture,
+                             Vertex *vertices) {
+  const Rectangle &rect = tile.rect;
+  Rectangle source = {tile.coords.x, tile.coords.y, tile.width, tile.height};
+  bool flip_x = source.width < 0;
+  if (flip_x) {
+    source.width *= -1;
+  }
+  if (source.height < 0) {
+    source.y -= source.height;
+  }
+
+  float radians = tile.rotation * DEG2RAD;
+  float cos = std::cos(radians);
+  float sin = std::sin(radians);
+  Vector2 top_left = {rect.x, rect.y};
+  Vector2 top_right = {rect.x + rect.width * cos, rect.y + rect.width * sin};
+  Vector2 bottom_left = {rect.x - rect.height * sin,
+                         rect.y + rect.height * cos};
+  Vector2 bottom_right = {top_right.x - rect.height * sin,
+                          top_right.y + rect.height * cos};
+
+  float left = source.x / texture.width;
+  float right = (source.x + source.width) / texture.width;
+  if (flip_x) {
+    std::swap(left, right);
+  }
+  float top = source.y / texture.height;
+  float bottom = (source.y + source.height) / texture.height;
+
+  vertices[0] = {top_left.x, top_left.y, left, top};
+  vertices[1] = {bottom_left.x, bottom_left.y, left, bottom};
+  vertices[2] = {bottom_right.x, bottom_right.y, right, bottom};
+  vertices[3] = {top_left.x, top_left.y, left, top};
+  vertices[4] = {bottom_right.x, bottom_right.y, right, bottom};
+  vertices[5] = {top_right.x, top_right.y, right, top};
+}
+
+// ----------------------------------------------------------------------------------------------------
+void TileMesh::update(const TileBatch &batch, const TileGeometry &geometry,
+                      const Texture2D &texture) {
+  m_Blocks.build(batch);
+  m_ScreenTileSize = geometry.screen_tile_size;
+
+  std::vector<Vertex> vertices(batch.tiles.size() * vertices_per_tile);
+  for (size_t i = 0; i < batch.tiles.size(); ++i) {
+    tile_vertices(make_tile(geometry, batch.tiles[m_Blocks.order()[i]]),
+                  texture, &vertices[i * vertices_per_tile]);
+  }
+
+  // Patch the runs of changed tiles in place.
+  if (m_VertexBuffer != 0 && vertices.size() == m_Vertices.size()) {
+    constexpr size_t tile_size = vertices_per_tile * sizeof(Vertex);
+    size_t tiles = tile_count();
+    for (size_t first = 0; first < tiles;) {
+      auto differs = [&](size_t tile) {
+        return std::memcmp(&vertices[tile * vertices_per_tile],
+                           &m_Vertices[tile * vertices_per_tile],
+                           tile_size) != 0;
+      };
+      if (!differs(first)) {
+        ++first;
+        continue;
+      }
+      size_t last = first + 1;
+      while (last < tiles && differs(last)) {
+        ++last;
+      }
+      rlUpdateVertexBuffer(m_VertexBuffer,
+                           &vertices[first * vertices_per_tile],
+                           static_cast<int>((last - first) * tile_size),
+                           static_cast<int>(first * tile_size));
+      first = last;
+    }
+    m_Vertices = std::move(vertices);
+    return;
+  }
+
+  unload();
+  m_Vertices = std::move(vertices);
+  if (m_Vertices.empty()) {
+    return;
+  }
+
+  m_VertexArray = rlLoadVertexArray();
+  rlEnableVertexArray(m_VertexArray);
+  m_VertexBuffer = rlLoadVertexBuffer(
+      m_Vertices.data(), static_cast<int>(m_Vertices.size() * sizeof(Vertex)),
+      true);
+  rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, 2, RL_FLOAT,
+                       false, sizeof(Vertex), offsetof(Vertex, x));
+  rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION);
+  rlSetVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, 2, RL_FLOAT,
+                       false, sizeof(Vertex), offsetof(Vertex, u));
+  rlEnableVertexAttribute(RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD);
+  rlDisableVertexArray();
+}
+
+// ----------------------------------------------------------------------------------------------------
+void TileMesh::draw(const Texture2D &texture, Rectangle view) const {
+  if (m_VertexArray == 0 || texture.id == 0) {
+    return;
+  }
+  rlDrawRenderBatchActive();
+
+  // Draw with raylib's default shader, like the batched draws do.
+  int *locations = rlGetShaderLocsDefault();
+  rlEnableShader(rlGetShaderIdDefault());
+  rlSetUniformMatrix(locations[RL_SHADER_LOC_MATRIX_MVP],
+                     MatrixMultiply(rlGetMatrixModelview(),
+                                    rlGetMatrixProjection()));
+  float white[4] = {1.f, 1.f, 1.f, 1.f};
+  rlSetUniform(locations[RL_SHADER_LOC_COLOR_DIFFUSE], white,
+               RL_SHADER_UNIFORM_VEC4, 1);
+  int slot = 0;
+  rlSetUniform(locations[RL_SHADER_LOC_MAP_DIFFUSE], &slot,
+               RL_SHADER_UNIFORM_INT, 1);
+  rlActiveTextureSlot(slot);
+  rlEnableTexture(texture.id);
+
+  rlEnableVertexArray(m_VertexArray);
+  // The mesh has no vertex colors.
+  rlSetVertexAttributeDefault(RL_DEFAULT_SHADER_ATTRIB_LOCATION_COLOR, white,
+                              RL_SHADER_ATTRIB_VEC4, 4);
+  m_Blocks.for_each_visible(view, m_ScreenTileSize,
+                            [](uint32_t first, uint32_t count) {
+                              rlDrawVertexArray(
+                                  static_cast<int>(first * vertices_per_tile),
+                                  static_cast<int>(count * vertices_per_tile));
+                            });
+  rlDisableVertexArray();
+
+  rlDisableTexture();
+  rlDisableShader();
+}
+
+// ----------------------------------------------------------------------------------------------------
+void TileMesh::unload() {
+  if (m_VertexArray != 0) {
+    rlUnloadVertexBuffer(m_VertexBuffer);
+    rlUnloadVertexArray(m_VertexArray);
+  }
+  m_VertexArray = m_VertexBuffer = 0;
+  m_Vertices.clear();
+}
+} // namespace Inversion
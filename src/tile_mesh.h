@@ -0,0 +1,65 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "raylib.h"
+
+#include "./tile_blocks.h"
+#include "./tile_builder.h"
+#include "./tile_mapping.h"
+
+namespace Inversion {
+// ----------------------------------------------------------------------------------------------------
+// The tiles of a batch in one vertex buffer, grouped by block. Flips and
+// rotations are baked into the vertices, drawing takes one draw call per row
+// of blocks in view. Has to be unloaded while the window is open.
+class TileMesh {
+public:
+  TileMesh() = default;
+  TileMesh(const TileMesh &) = delete;
+  TileMesh &operator=(const TileMesh &) = delete;
+
+  // Upload the tiles of the batch, with texture coordinates on the given
+  // texture. If the number of tiles didn't change, only the tiles that differ
+  // from the previous update are written to the buffer.
+  void update(const TileBatch &batch, const TileGeometry &geometry,
+              const Texture2D &texture);
+
+  // Draw the tiles of the blocks the view overlaps. Draws queued before are
+  // flushed first, so the order of the draw calls is kept.
+  void draw(const Texture2D &texture, Rectangle view) const;
+
+  void unload();
+
+  size_t tile_count() const { return m_Vertices.size() / vertices_per_tile; }
+
+private:
+  struct Vertex {
+    float x, y;
+    float u, v;
+  };
+
+  // Two triangles without an index buffer.
+  static constexpr size_t vertices_per_tile = 6;
+
+  static void tile_vertices(const TileEntry &tile, const Texture2D &texture,
+                            Vertex *vertices);
+
+  // Copy of the buffer, to find the tiles that changed.
+  std::vector<Vertex> m_Vertices;
+  TileBlocks m_Blocks;
+  Vector2 m_ScreenTileSize = {};
+  unsigned int m_VertexArray = 0;
+  unsigned int m_VertexBuffer = 0;
+};
+} // namespace Inversion
@@ -0,0 +1,238 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+// ----------------------------------------------------------------------------------------------------
+// Benchmark: memory and iteration cost of the packed tile batches against
+// the parallel vector layout they replaced, on the compiled levels. The
+// iteration computes the DrawTexturePro arguments of every tile like the
+// draw loop does. Cached levels and streamed chunks keep their batches
+// packed, which is where the memory is saved. The static layers are only
+// unpacked when they are uploaded, and the animated tiles, which are drawn
+// every frame, are unpacked into TileEntry arrays once, which are measured
+// as well. The shipped levels fit into the cache, repeat them with the
+// copies argument to measure bigger maps.
+//
+// Usage: ./bench_tiles [iterations] [copies]
+// ----------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../src/level_format.h"
+#include "../src/mapped_file.h"
+#include "../src/tile_builder.h"
+
+using namespace Inversion;
+namespace fs = std::filesystem;
+
+// Previous layout: every draw argument of a tile in its own vector.
+struct VectorBatch {
+  std::vector<Rectangle> rects;
+  std::vector<Vector2> coords;
+  std::vector<float> rotation;
+  std::vector<float> width;
+  std::vector<float> height;
+  std::vector<uint32_t> gids;
+  std::vector<uint32_t> tiles;
+
+  size_t bytes() const {
+    return rects.size() * sizeof(Rectangle) + coords.size() * sizeof(Vector2) +
+           (rotation.size() + width.size() + height.size()) * sizeof(float) +
+           (gids.size() + tiles.size()) * sizeof(uint32_t);
+  }
+};
+
+// The same tiles in the previous layout.
+static VectorBatch unpack(const TileBatch &batch,
+                          const TileGeometry &geometry) {
+  VectorBatch unpacked;
+  for (const PackedTile &tile : batch.tiles) {
+    TileEntry entry = make_tile(geometry, tile);
+    unpacked.rects.push_back(entry.rect);
+    unpacked.coords.push_back(entry.coords);
+    unpacked.rotation.push_back(entry.rotation);
+    unpacked.width.push_back(entry.width);
+    unpacked.height.push_back(entry.height);
+    unpacked.gids.push_back(tile.tile);
+  }
+  unpacked.tiles = batch.indices;
+  return unpacked;
+}
+
+// The draw arguments of the tiles, as the animated tiles are kept.
+static std::vector<TileEntry> entries(const TileBatch &batch,
+                                      const TileGeometry &geometry) {
+  std::vector<TileEntry> unpacked;
+  for (const PackedTile &tile : batch.tiles) {
+    unpacked.push_back(make_tile(geometry, tile));
+  }
+  return unpacked;
+}
+
+static size_t bytes(const TileBatch &batch) {
+  return batch.tiles.size() * sizeof(PackedTile) +
+         batch.indices.size() * sizeof(uint32_t);
+}
+
+// Sum of the draw arguments, so the loops can't be optimized away.
+static float draw_arguments(const VectorBatch &batch) {
+  float sum = 0;
+  for (size_t i = 0; i < batch.coords.size(); ++i) {
+    sum += batch.coords[i].x + batch.coords[i].y + batch.width[i] +
+           batch.height[i] + batch.rects[i].x + batch.rects[i].y +
+           batch.rects[i].width + batch.rects[i].height + batch.rotation[i];
+  }
+  return sum;
+}
+
+static float draw_arguments(const std::vector<TileEntry> &batch) {
+  float sum = 0;
+  for (const TileEntry &entry : batch) {
+    sum += entry.coords.x + entry.coords.y + entry.width + entry.height +
+           entry.rect.x + entry.rect.y + entry.rect.width + entry.rect.height +
+           entry.rotation;
+  }
+  return sum;
+}
+
+static float draw_arguments(const TileBatch &batch,
+                            const TileGeometry &geometry) {
+  float sum = 0;
+  for (const PackedTile &tile : batch.tiles) {
+    TileEntry entry = make_tile(geometry, tile);
+    sum += entry.coords.x + entry.coords.y + entry.width + entry.height +
+           entry.rect.x + entry.rect.y + entry.rect.width + entry.rect.height +
+           entry.rotation;
+  }
+  return sum;
+}
+
+template <typename Iterate>
+static double measure(int iterations, float &checksum, Iterate iterate) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    checksum += iterate();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+auto main(int argc, char **argv) -> int {
+  int iterations = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int copies = argc > 2 ? std::atoi(argv[2]) : 1;
+
+  // Keep the files mapped, the built levels don't own their views.
+  std::vector<MappedFile> files;
+  std::vector<TileMapping> levels;
+  for (const auto &entry : fs::directory_iterator("./Assets/Levels")) {
+    LevelFormat::LevelView view;
+    files.emplace_back();
+    if (entry.path().extension() == ".lvl" &&
+        LevelFormat::map_binary(entry.path().string(), files.back(), view) &&
+        view.header.chunk_size == 0) {
+      levels.push_back(build_tile_mapping(view));
+    }
+  }
+  if (levels.empty()) {
+    std::fprintf(stderr, "No compiled levels found, run make cook from the "
+                         "repository root.\n");
+    return 1;
+  }
+
+  std::vector<VectorBatch> vector_batches;
+  std::vector<const TileGeometry *> geometries;
+  size_t tile_count = 0;
+  size_t max_animated = 0;
+  size_t vector_bytes = 0;
+  size_t packed_bytes = 0;
+  std::vector<TileBatch> packed_copies;
+  std::vector<std::vector<TileEntry>> entry_batches;
+  for (int copy = 0; copy < copies; ++copy) {
+    for (const TileMapping &level : levels) {
+      const TileBatch &animated =
+          level.batch(LevelFormat::LayerRole::ANIMATED);
+      max_animated = std::max(max_animated, animated.tiles.size());
+      for (const TileBatch &batch : level.batches) {
+        vector_batches.push_back(unpack(batch, level.geometry));
+        packed_copies.push_back(batch);
+        entry_batches.push_back(entries(batch, level.geometry));
+        geometries.push_back(&level.geometry);
+        tile_count += batch.tiles.size();
+        vector_bytes += vector_batches.back().bytes();
+        packed_bytes += bytes(batch);
+      }
+    }
+  }
+
+  float vector_checksum = 0;
+  float packed_checksum = 0;
+  float entry_checksum = 0;
+  double vector_seconds = measure(iterations, vector_checksum, [&] {
+    float sum = 0;
+    for (const VectorBatch &batch : vector_batches) {
+      sum += draw_arguments(batch);
+    }
+    return sum;
+  });
+  double packed_seconds = measure(iterations, packed_checksum, [&] {
+    float sum = 0;
+    for (size_t i = 0; i < packed_copies.size(); ++i) {
+      sum += draw_arguments(packed_copies[i], *geometries[i]);
+    }
+    return sum;
+  });
+  double entry_seconds = measure(iterations, entry_checksum, [&] {
+    float sum = 0;
+    for (const auto &batch : entry_batches) {
+      sum += draw_arguments(batch);
+    }
+    return sum;
+  });
+
+  double tiles = static_cast<double>(tile_count) * iterations;
+  std::printf("%zu levels x %d, %zu tiles, %d iterations\n", levels.size(),
+              copies, tile_count, iterations);
+  std::printf("Vectors: %8zu bytes (%.1f per tile), %6.2f ns per tile\n",
+              vector_bytes, static_cast<double>(vector_bytes) / tile_count,
+              vector_seconds * 1e9 / tiles);
+  std::printf("Packed:  %8zu bytes (%.1f per tile), %6.2f ns per tile\n",
+              packed_bytes, static_cast<double>(packed_bytes) / tile_count,
+              packed_seconds * 1e9 / tiles);
+  std::printf("Entries: %8zu bytes (%.1f per tile), %6.2f ns per tile\n",
+              tile_count * sizeof(TileEntry),
+              static_cast<double>(sizeof(TileEntry)),
+              entry_seconds * 1e9 / tiles);
+  std::printf("Memory: %.2fx smaller, iteration: %.2fx packed, %.2fx "
+              "entries\n",
+              static_cast<double>(vector_bytes) / packed_bytes,
+              vector_seconds / packed_seconds, vector_seconds / entry_seconds);
+  // The packed tiles are unpacked once per upload, and the animated entries
+  // of the uploaded level come on top of its packed batches.
+  double level_count = static_cast<double>(levels.size()) * copies;
+  std::printf("Upload: %.1f us per level unpacking packed tiles, %.1f us "
+              "reading vectors\n",
+              packed_seconds * 1e6 / iterations / level_count,
+              vector_seconds * 1e6 / iterations / level_count);
+  std::printf("Animated: at most %zu tiles per level, %zu bytes of entries\n",
+              max_animated,
+              max_animated * (sizeof(TileEntry) + sizeof(int32_t)));
+
+  if (vector_checksum != packed_checksum ||
+      vector_checksum != entry_checksum) {
+    std::fprintf(stderr, "Checksum mismatch between the layouts!\n");
+    return 1;
+  }
+  return 0;
+}
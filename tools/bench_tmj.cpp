@@ -0,0 +1,119 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+// ----------------------------------------------------------------------------------------------------
+// Benchmark: Tiled map parsing throughput of the streaming (SAX) loader
+// against the JSON DOM path it replaced, on the shipped levels.
+//
+// Usage: ./bench_tmj [iterations]
+// ----------------------------------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+#include "../src/level_format.h"
+#include "../src/mapped_file.h"
+
+using json = nlohmann::json;
+namespace fs = std::filesystem;
+
+// Previous loader: parse into a DOM and index every tile through it.
+static size_t parse_dom(const char *data, size_t size) {
+  json level_data = json::parse(data, data + size);
+
+  int width = static_cast<int>(level_data["layers"][0]["width"]);
+  int height = static_cast<int>(level_data["layers"][0]["height"]);
+
+  size_t checksum = 0;
+  for (int index = 0; index < width * height; ++index) {
+    unsigned gid = level_data["layers"][0]["data"][index];
+    checksum += gid;
+  }
+  return checksum;
+}
+
+// Current loader, reusing the level between runs like the game does.
+static size_t parse_sax(const char *data, size_t size,
+                        Inversion::LevelFormat::LevelData &level) {
+  Inversion::LevelFormat::parse_tmj(data, size, level);
+
+  size_t checksum = 0;
+  for (uint32_t gid : level.gids) {
+    checksum += gid;
+  }
+  return checksum;
+}
+
+template <typename Parse>
+static double measure(const std::vector<Inversion::MappedFile> &files,
+                      int iterations, size_t &checksum, Parse parse) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    for (const auto &file : files) {
+      checksum += parse(reinterpret_cast<const char *>(file.data()),
+                        file.size());
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+auto main(int argc, char **argv) -> int {
+  int iterations = argc > 1 ? std::atoi(argv[1]) : 50;
+
+  std::vector<Inversion::MappedFile> files;
+  size_t total_bytes = 0;
+  for (const auto &entry : fs::directory_iterator("./Assets/JSON")) {
+    if (entry.path().extension() == ".tmj") {
+      files.emplace_back(entry.path().string());
+      total_bytes += files.back().size();
+    }
+  }
+  if (files.empty()) {
+    std::fprintf(stderr, "No levels found, run from the repository root.\n");
+    return 1;
+  }
+
+  Inversion::LevelFormat::LevelData level;
+  size_t dom_checksum = 0;
+  size_t sax_checksum = 0;
+
+  double dom_seconds =
+      measure(files, iterations, dom_checksum,
+              [](const char *data, size_t size) {
+                return parse_dom(data, size);
+              });
+  double sax_seconds =
+      measure(files, iterations, sax_checksum,
+              [&](const char *data, size_t size) {
+                return parse_sax(data, size, level);
+              });
+
+  double megabytes = total_bytes * static_cast<double>(iterations) / 1e6;
+  std::printf("%zu levels, %zu bytes, %d iterations\n", files.size(),
+              total_bytes, iterations);
+  std::printf("DOM: %8.2f MB/s (%.3f ms per level)\n", megabytes / dom_seconds,
+              dom_seconds * 1e3 / (files.size() * iterations));
+  std::printf("SAX: %8.2f MB/s (%.3f ms per level)\n", megabytes / sax_seconds,
+              sax_seconds * 1e3 / (files.size() * iterations));
+  std::printf("Speedup: %.2fx\n", dom_seconds / sax_seconds);
+
+  if (dom_checksum != sax_checksum) {
+    std::fprintf(stderr, "Checksum mismatch between DOM and SAX paths!\n");
+    return 1;
+  }
+  return 0;
+}
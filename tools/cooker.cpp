@@ -0,0 +1,372 @@
+//   ___                         _
+//  |_ _|_ ____   _____ _ __ ___(_) ___  _ __
+//   | ||  _ \ \ / / _ \  __/ __| |/ _ \|  __ \
+//   | || | | \ V /  __/ |  \__ \ | (_) | | | |
+//  |___|_| |_|\_/ \___|_|  |___/_|\___/|_| |_|
+//
+// Copyright (C) 2024
+// Author: Johannes Elsing <je305@students.uni-freiburg.de>
+
+// ----------------------------------------------------------------------------------------------------
+// Asset cooker: converts the authored assets into the formats the game loads
+// without further processing. Each step is a cook_ function below, main runs
+// them in order and writes their outputs to the Cooked directory.
+//
+// Every output is listed in a manifest together with a hash of its inputs,
+// outputs whose inputs haven't changed since the last run are skipped.
+//
+// Usage: ./cooker [assets directory]
+// ----------------------------------------------------------------------------------------------------
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "raylib.h"
+
+#include "../src/asset_pack.h"
+#include "../src/level_format.h"
+#include "../src/texture_atlas.h"
+
+namespace fs = std::filesystem;
+using namespace Inversion;
+
+// Bump when an output format changes to cook everything again.
+static constexpr uint64_t COOKER_VERSION = 2;
+
+// Sounds are decoded into 16-bit samples when loaded, cooking them into that
+// format at the rate of the audio device leaves no conversion but to float.
+static constexpr int SOUND_SAMPLE_RATE = 44100;
+static constexpr int SOUND_SAMPLE_SIZE = 16;
+static constexpr int SOUND_CHANNELS = 2;
+
+// ----------------------------------------------------------------------------------------------------
+// 64-bit FNV-1a hash, chained over several inputs through the seed.
+static uint64_t fnv1a(const void *data, size_t size,
+                      uint64_t hash = 14695981039346656037ull) {
+  const auto *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+static uint64_t hash_file(const fs::path &path, uint64_t hash) {
+  std::ifstream file(path, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+  std::string name = path.generic_string();
+  hash = fnv1a(name.data(), name.size(), hash);
+  return fnv1a(content.data(), content.size(), hash);
+}
+
+static uint64_t hash_files(const std::vector<fs::path> &paths,
+                           uint64_t hash) {
+  hash = fnv1a(&COOKER_VERSION, sizeof(COOKER_VERSION), hash);
+  for (const auto &path : paths) {
+    hash = hash_file(path, hash);
+  }
+  return hash;
+}
+
+// Files with the given extension in a directory and its subdirectories,
+// sorted so that hashes don't depend on the directory order.
+static std::vector<fs::path> find_files(const fs::path &directory,
+                                        const std::string &extension) {
+  std::vector<fs::path> files;
+  std::error_code error;
+  for (const auto &entry :
+       fs::recursive_directory_iterator(directory, error)) {
+    if (entry.is_regular_file() && entry.path().extension() == extension) {
+      files.push_back(entry.path());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Input hashes of the cooked outputs, one "<hash> <output>" per line.
+class Manifest {
+public:
+  explicit Manifest(fs::path path) : m_Path(std::move(path)) {
+    std::ifstream file(m_Path);
+    std::string output;
+    uint64_t hash;
+    while (file >> std::hex >> hash >> output) {
+      m_Hashes[output] = hash;
+    }
+  }
+
+  // Checks if the output exists and was cooked from the same inputs.
+  bool current(const fs::path &output, uint64_t hash) const {
+    auto it = m_Hashes.find(output.generic_string());
+    return it != m_Hashes.end() && it->second == hash && fs::exists(output);
+  }
+
+  void update(const fs::path &output, uint64_t hash) {
+    m_Hashes[output.generic_string()] = hash;
+  }
+
+  bool save() const {
+    std::ofstream file(m_Path);
+    for (const auto &[output, hash] : m_Hashes) {
+      file << std::hex << hash << ' ' << output << '\n';
+    }
+    return static_cast<bool>(file);
+  }
+
+private:
+  fs::path m_Path;
+  std::map<std::string, uint64_t> m_Hashes;
+};
+
+// ----------------------------------------------------------------------------------------------------
+// Compile the Tiled maps next to where the game looks for compiled levels.
+static bool cook_levels(const fs::path &assets, Manifest &manifest,
+                        int &cooked) {
+  // External tilesets are shared by the maps, changing one recooks them all.
+  std::vector<fs::path> tilesets = find_files(assets / "JSON", ".tsx");
+  uint64_t format = LevelFormat::VERSION;
+  uint64_t seed = hash_files(tilesets, fnv1a(&format, sizeof(format)));
+
+  bool ok = true;
+  for (int id = 1;; ++id) {
+    std::string name = "level_" + std::to_string(id);
+    fs::path source = assets / "JSON" / (name + ".tmj");
+    if (!fs::exists(source)) {
+      break;
+    }
+
+    // The tileset image is only known once the map is parsed.
+    LevelFormat::LevelData level;
+    if (!LevelFormat::parse_tmj(source.string(), level)) {
+      std::fprintf(stderr, "Could not cook %s\n", source.c_str());
+      ok = false;
+      continue;
+    }
+
+    fs::path output = assets / "Levels" / (name + ".lvl");
+    std::vector<fs::path> inputs = {source};
+    if (!level.tileset_image.empty()) {
+      inputs.push_back(level.tileset_image);
+    }
+    uint64_t hash = hash_files(inputs, seed);
+    if (manifest.current(output, hash)) {
+      continue;
+    }
+
+    // Mark the tiles of a single colour, the game merges their runs.
+    if (!level.tileset_image.empty()) {
+      Image tileset = LoadImage(level.tileset_image.c_str());
+      ImageFormat(&tileset, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+      LevelFormat::mark_fill_tiles(level,
+                                   static_cast<const Color *>(tileset.data),
+                                   tileset.width, tileset.height);
+      UnloadImage(tileset);
+    }
+
+    fs::create_directories(output.parent_path());
+    if (!LevelFormat::write_binary(output.string(), level)) {
+      std::fprintf(stderr, "Could not cook %s\n", source.c_str());
+      ok = false;
+      continue;
+    }
+    manifest.update(output, hash);
+    cooked++;
+  }
+  return ok;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Pack the sprites of every atlas page listed in texture_atlas.h. A page is
+// written as an image and a description of where its sprites are.
+static bool cook_atlas(const fs::path &assets, Manifest &manifest,
+                       int &cooked) {
+  bool ok = true;
+  for (size_t page = 0; page < ATLAS_PAGE_COUNT; ++page) {
+    std::vector<const char *> names;
+    std::vector<fs::path> inputs;
+    for (const AtlasEntry &entry : ATLAS_ENTRIES) {
+      if (entry.page == page) {
+        names.push_back(entry.sprite);
+        inputs.push_back(assets / entry.sprite);
+      }
+    }
+
+    fs::path output = assets / "Cooked" / ATLAS_PAGES[page];
+    fs::path image = fs::path(output).replace_extension(".png");
+    fs::path description = fs::path(output).replace_extension(".atlas");
+    uint64_t hash = hash_files(inputs, fnv1a(&ATLAS_PADDING, sizeof(int)));
+    if (manifest.current(image, hash) && manifest.current(description, hash)) {
+      continue;
+    }
+
+    std::vector<AtlasSprite> sprites;
+    for (const auto &path : inputs) {
+      Image sprite = LoadImage(path.string().c_str());
+      if (sprite.data == nullptr) {
+        std::fprintf(stderr, "Could not load sprite %s\n", path.c_str());
+        break;
+      }
+      ImageFormat(&sprite, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+      sprites.push_back({sprite, {}});
+    }
+    Image atlas = sprites.size() == inputs.size() ? pack_atlas(sprites)
+                                                  : Image{};
+    std::string text = describe_atlas(names, sprites);
+    for (auto &sprite : sprites) {
+      UnloadImage(sprite.image);
+    }
+    if (atlas.data == nullptr) {
+      std::fprintf(stderr, "Could not pack atlas page %s\n",
+                   ATLAS_PAGES[page]);
+      ok = false;
+      continue;
+    }
+
+    fs::create_directories(image.parent_path());
+    std::ofstream file(description);
+    file << text;
+    file.close();
+    bool written = ExportImage(atlas, image.string().c_str()) && file;
+    UnloadImage(atlas);
+    if (!written) {
+      std::fprintf(stderr, "Could not write atlas page %s\n", image.c_str());
+      ok = false;
+      continue;
+    }
+    manifest.update(image, hash);
+    manifest.update(description, hash);
+    cooked++;
+  }
+  return ok;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Transcode the sound effects. Music is streamed and stays compressed.
+static bool cook_sounds(const fs::path &assets, Manifest &manifest,
+                        int &cooked) {
+  bool ok = true;
+  for (const char *extension : {".wav", ".ogg", ".mp3", ".flac"}) {
+    for (const auto &source : find_files(assets / "Sound", extension)) {
+      fs::path output = assets / "Cooked" /
+                        fs::relative(source, assets).replace_extension(".wav");
+      uint64_t hash = hash_files({source}, 0);
+      if (manifest.current(output, hash)) {
+        continue;
+      }
+
+      Wave wave = LoadWave(source.string().c_str());
+      if (wave.data == nullptr) {
+        std::fprintf(stderr, "Could not load sound %s\n", source.c_str());
+        ok = false;
+        continue;
+      }
+      WaveFormat(&wave, SOUND_SAMPLE_RATE, SOUND_SAMPLE_SIZE, SOUND_CHANNELS);
+      fs::create_directories(output.parent_path());
+      bool written = ExportWave(wave, output.string().c_str());
+      UnloadWave(wave);
+      if (!written) {
+        std::fprintf(stderr, "Could not write sound %s\n", output.c_str());
+        ok = false;
+        continue;
+      }
+      manifest.update(output, hash);
+      cooked++;
+    }
+  }
+  return ok;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// Bundle the textures, fonts, sounds, music and compiled levels into the
+// asset pack, using the cooked version of an asset where there is one.
+static bool cook_pack(const fs::path &assets, Manifest &manifest,
+                      int &cooked) {
+  struct Source {
+    fs::path path;
+    AssetType type;
+  };
+  std::vector<Source> sources;
+  auto add = [&](const char *directory, const char *extension,
+                 AssetType type) {
+    for (const auto &path : find_files(assets / directory, extension)) {
+      sources.push_back({path, type});
+    }
+  };
+  add("Sprites", ".png", AssetType::IMAGE);
+  add("Fonts", ".png", AssetType::FONT);
+  add("Fonts", ".ttf", AssetType::FONT);
+  add("Cooked/Sound", ".wav", AssetType::SOUND);
+  add("Cooked/Atlas", ".png", AssetType::IMAGE);
+  add("Cooked/Atlas", ".atlas", AssetType::DATA);
+  add("Music", ".ogg", AssetType::MUSIC);
+  add("Levels", ".lvl", AssetType::LEVEL);
+
+  std::vector<fs::path> paths;
+  for (const auto &source : sources) {
+    paths.push_back(source.path);
+  }
+  fs::path output = assets / "Cooked" / "assets.pack";
+  uint64_t hash =
+      hash_files(paths, fnv1a(&PACK_VERSION, sizeof(PACK_VERSION)));
+  if (manifest.current(output, hash)) {
+    return true;
+  }
+
+  std::vector<PackInput> inputs;
+  for (const auto &source : sources) {
+    // Cooked assets replace the original of the same name.
+    fs::path name = fs::relative(source.path, assets);
+    if (*name.begin() == "Cooked") {
+      name = fs::relative(source.path, assets / "Cooked");
+    }
+
+    std::ifstream file(source.path, std::ios::binary);
+    inputs.push_back({name.generic_string(), source.type,
+                      {std::istreambuf_iterator<char>(file),
+                       std::istreambuf_iterator<char>()}});
+  }
+
+  if (!write_pack(output.string(), std::move(inputs))) {
+    std::fprintf(stderr, "Could not write the asset pack\n");
+    return false;
+  }
+  manifest.update(output, hash);
+  cooked++;
+  return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+auto main(int argc, char **argv) -> int {
+  fs::path assets = argc > 1 ? argv[1] : "./Assets";
+  if (!fs::exists(assets / "JSON")) {
+    std::fprintf(stderr, "No assets found in %s\n", assets.c_str());
+    return 1;
+  }
+  SetTraceLogLevel(LOG_WARNING);
+
+  fs::create_directories(assets / "Cooked");
+  Manifest manifest(assets / "Cooked" / "manifest.txt");
+
+  int cooked = 0;
+  bool ok = cook_levels(assets, manifest, cooked);
+  ok = cook_atlas(assets, manifest, cooked) && ok;
+  ok = cook_sounds(assets, manifest, cooked) && ok;
+  // The pack takes the cooked atlas pages and sounds, so it comes last.
+  ok = cook_pack(assets, manifest, cooked) && ok;
+
+  if (!manifest.save()) {
+    std::fprintf(stderr, "Could not write the manifest\n");
+    return 1;
+  }
+  std::printf("Cooked %d assets\n", cooked);
+  return ok ? 0 : 1;
+}